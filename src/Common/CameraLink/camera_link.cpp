@@ -0,0 +1,57 @@
+#include "camera_link.h"
+#include <string.h>
+
+// payload length of the first version of each type, longer payloads are newer versions
+static const uint8_t minimumLength[CAMERA_Link_Types] = { 0, sizeof(CAMERA_HEADING), sizeof(CAMERA_OBSTACLES), sizeof(CAMERA_HEALTH) };
+
+size_t CAMERA_LINK::encode(uint8_t type, const void* payload, uint8_t length, uint8_t* message) {
+    if(length > CAMERA_LINK_MAX_PAYLOAD) return 0;
+    message[0] = type;
+    message[1] = CAMERA_LINK_VERSION;
+    message[2] = _sequence++;
+    message[3] = length;
+    memcpy(message + CAMERA_LINK_HEADER_SIZE, payload, length);
+    uint16_t crc = crc16(message, CAMERA_LINK_HEADER_SIZE + length);
+    message[CAMERA_LINK_HEADER_SIZE + length] = crc >> 8;
+    message[CAMERA_LINK_HEADER_SIZE + length + 1] = crc & 0xff;
+    return CAMERA_LINK_HEADER_SIZE + length + 2;
+}
+
+bool CAMERA_LINK::decode(const uint8_t* message, size_t length, CAMERA_LINK_MESSAGE* decoded) {
+    if((length < CAMERA_LINK_HEADER_SIZE + 2) || (length != (size_t)CAMERA_LINK_HEADER_SIZE + message[3] + 2)) {
+        stats.corrupted++;
+        return false;
+    }
+    uint8_t payloadLength = message[3];
+    uint16_t crc = ((uint16_t)message[CAMERA_LINK_HEADER_SIZE + payloadLength] << 8) | message[CAMERA_LINK_HEADER_SIZE + payloadLength + 1];
+    if(crc16(message, CAMERA_LINK_HEADER_SIZE + payloadLength) != crc) {
+        stats.corrupted++;
+        return false;
+    }
+
+    // the sequence is checked on every intact message, also on unknown types,
+    // a jump backwards is a restart of WRO Camera and not counted
+    uint8_t gap = message[2] - _sequence;
+    if(_synchronised && (gap < 0x80)) {
+        stats.dropped += gap;
+    }
+    _sequence = message[2] + 1;
+    _synchronised = true;
+
+    uint8_t type = message[0];
+    if((type == 0) || (type >= CAMERA_Link_Types)) {
+        stats.unknown++;
+        return false;
+    }
+    if(payloadLength < minimumLength[type]) {
+        stats.corrupted++;
+        return false;
+    }
+    decoded->type = type;
+    decoded->version = message[1];
+    decoded->sequence = message[2];
+    memset(decoded->payload, 0, sizeof(decoded->payload));
+    memcpy(decoded->payload, message + CAMERA_LINK_HEADER_SIZE, (payloadLength < sizeof(decoded->payload)) ? payloadLength : sizeof(decoded->payload));
+    stats.received++;
+    return true;
+}
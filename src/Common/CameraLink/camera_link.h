@@ -0,0 +1,90 @@
+#ifndef CAMERA_LINK_H
+#define CAMERA_LINK_H
+
+/**
+ * Camera link protocol library
+ * shared by WRO Main, WRO Camera and WRO Tools
+ * by TerraForce
+ *
+ * One message per I2C write of WRO Camera: type, version, sequence, payload length,
+ * payload and CRC-16 over all of them. The header never changes. Newer versions only
+ * append payload fields, a receiver reads the fields it knows and zero fills the ones
+ * an older sender does not send, so mixed firmware versions keep working.
+*/
+
+#define CAMERA_LINK_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+#include <stddef.h>
+#include "framing.h"
+
+#define CAMERA_LINK_VERSION         1
+#define CAMERA_LINK_HEADER_SIZE     4
+#define CAMERA_LINK_MAX_MESSAGE     32      // one AVR or ESP32 I2C buffer
+#define CAMERA_LINK_MAX_PAYLOAD     (CAMERA_LINK_MAX_MESSAGE - CAMERA_LINK_HEADER_SIZE - 2)
+#define CAMERA_LINK_MAX_OBSTACLES   4
+
+enum CAMERA_LINK_TYPES {
+    CAMERA_Heading = 1,
+    CAMERA_Obstacles,
+    CAMERA_Health,
+    CAMERA_Link_Types
+};
+
+enum CAMERA_HEALTH_ERRORS {
+    CAMERA_Capture_Failed = 0x01
+};
+
+#pragma pack(push, 1)
+struct CAMERA_HEADING {
+    int32_t rotation;                               // 1/10 degrees, positive clockwise
+};
+
+struct CAMERA_OBSTACLES {
+    uint8_t count;
+    uint8_t objects[CAMERA_LINK_MAX_OBSTACLES];     // nearest first, bit 0 available, bit 1 color, bit 2 direction, bits 3-7 angle
+};
+
+struct CAMERA_HEALTH {
+    uint32_t uptime;                                // ms
+    uint16_t frameTime;                             // capture and analysis of the last frame in ms
+    uint16_t sendFailures;                          // I2C writes without acknowledge
+    uint8_t errors;                                 // CAMERA_HEALTH_ERRORS
+};
+#pragma pack(pop)
+
+struct CAMERA_LINK_MESSAGE {
+    uint8_t type;
+    uint8_t version;
+    uint8_t sequence;
+    union {
+        CAMERA_HEADING heading;
+        CAMERA_OBSTACLES obstacles;
+        CAMERA_HEALTH health;
+        uint8_t payload[CAMERA_LINK_MAX_PAYLOAD];
+    };
+};
+
+struct CAMERA_LINK_STATS {
+    uint32_t received;
+    uint32_t dropped;       // sequence numbers never received
+    uint32_t corrupted;     // wrong CRC, length or a payload shorter than its first version
+    uint32_t unknown;       // intact messages of a type this firmware does not know
+};
+
+class CAMERA_LINK {
+    public:
+        // returns the message length, the sequence counts up with every message
+        size_t encode(uint8_t type, const void* payload, uint8_t length, uint8_t* message);
+
+        // false if the message is rejected, the reason is counted in stats
+        bool decode(const uint8_t* message, size_t length, CAMERA_LINK_MESSAGE* decoded);
+
+        CAMERA_LINK_STATS stats = {};
+
+    private:
+        uint8_t _sequence = 0;
+        bool _synchronised = false;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "framing.h"
+
+uint16_t crc16(const uint8_t* data, size_t length, uint16_t crc) {
+    for(size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for(uint8_t j = 0; j < 8; j++) {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+size_t frameEncode(const uint8_t* payload, size_t length, uint8_t* frame) {
+    uint16_t crc = crc16(payload, length);
+    size_t codeIndex = 0;
+    size_t out = 1;
+    uint8_t code = 1;
+    for(size_t i = 0; i < length + 2; i++) {
+        uint8_t byte = (i < length) ? payload[i] : ((i == length) ? (uint8_t)(crc >> 8) : (uint8_t)crc);
+        if(byte != 0) {
+            frame[out++] = byte;
+            code++;
+        }
+        if((byte == 0) || (code == 0xff)) {
+            frame[codeIndex] = code;
+            codeIndex = out++;
+            code = 1;
+        }
+    }
+    frame[codeIndex] = code;
+    frame[out++] = FRAMING_DELIMITER;
+    return out;
+}
+
+size_t frameDecode(const uint8_t* frame, size_t length, uint8_t* payload, size_t maxLength) {
+    size_t out = 0;
+    size_t i = 0;
+    while(i < length) {
+        uint8_t code = frame[i++];
+        if((code == 0) || (i + code - 1 > length)) return 0;
+        for(uint8_t j = 1; j < code; j++) {
+            if(out >= maxLength) return 0;
+            payload[out++] = frame[i++];
+        }
+        if((code < 0xff) && (i < length)) {
+            if(out >= maxLength) return 0;
+            payload[out++] = 0;
+        }
+    }
+    if(out < 2) return 0;
+    out -= 2;
+    uint16_t crc = ((uint16_t)payload[out] << 8) | payload[out + 1];
+    return (crc16(payload, out) == crc) ? out : 0;
+}
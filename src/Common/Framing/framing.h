@@ -0,0 +1,27 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+/**
+ * COBS and CRC framing library
+ * shared by WRO Main, WRO Camera and WRO Tools
+ * by TerraForce
+*/
+
+#define FRAMING_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FRAMING_DELIMITER           0x00
+#define FRAMING_MAX_ENCODED(length) ((length) + 2 + 1 + ((length) + 2) / 254 + 1) // payload, CRC, COBS overhead, delimiter
+
+// CRC-16/CCITT-FALSE
+uint16_t crc16(const uint8_t* data, size_t length, uint16_t crc = 0xffff);
+
+// payload + CRC, COBS encoded and terminated by the delimiter, returns the frame length
+size_t frameEncode(const uint8_t* payload, size_t length, uint8_t* frame);
+
+// frame without the delimiter, returns the payload length or 0 if the frame is broken
+size_t frameDecode(const uint8_t* frame, size_t length, uint8_t* payload, size_t maxLength);
+
+#endif
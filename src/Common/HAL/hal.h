@@ -0,0 +1,130 @@
+#ifndef HAL_H
+#define HAL_H
+
+/**
+ * Hardware abstraction library
+ * shared by WRO Main, WRO Camera, WRO Servo and WRO Tools
+ * by TerraForce
+ *
+ * Arduino backend for the ESP32 and ATmega328 boards, native backend for Linux
+ * where pins, echoes, analog values and camera frames are set by the host program.
+*/
+
+#define HAL_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HAL_I2C_BUFFER_SIZE     32      // largest I2C transaction, the limit of the AVR Wire library
+#define HAL_STORAGE_SIZE        256     // persistent bytes
+
+enum HAL_PIN_MODES {
+    HAL_Input,
+    HAL_Output,
+    HAL_Input_Pullup
+};
+
+enum HAL_EDGES {
+    HAL_Rising,
+    HAL_Falling,
+    HAL_Change
+};
+
+#pragma region timing
+
+uint32_t halMillis();
+uint32_t halMicros();
+void halDelay(uint32_t ms);
+
+#pragma endregion timing
+
+
+#pragma region gpio
+
+void halPinMode(uint8_t pin, uint8_t mode);
+void halDigitalWrite(uint8_t pin, bool state);
+bool halDigitalRead(uint8_t pin);
+uint16_t halAnalogRead(uint8_t pin);
+
+// length of the next pulse in us, 0 on timeout
+uint32_t halPulseIn(uint8_t pin, bool state, uint32_t timeout = 1000000);
+
+bool halAttachInterrupt(uint8_t pin, void (*handler)(), uint8_t edge);
+
+#pragma endregion gpio
+
+
+#pragma region i2c
+
+// called with the bytes of a received write transaction
+typedef void (*HAL_I2C_RECEIVE)(const uint8_t* data, size_t length);
+
+// fills the answer of a read transaction, returns its length
+typedef size_t (*HAL_I2C_REQUEST)(uint8_t* data, size_t maxLength);
+
+class HAL_I2C {
+    public:
+        HAL_I2C(uint8_t bus);
+
+        // pins are ignored on boards with a fixed I2C port
+        bool beginMaster(uint8_t sda, uint8_t scl, uint32_t frequency);
+        bool beginSlave(uint8_t address, uint8_t sda, uint8_t scl, uint32_t frequency, HAL_I2C_RECEIVE onReceive, HAL_I2C_REQUEST onRequest = NULL);
+
+        bool write(uint8_t address, const uint8_t* data, size_t length);
+        size_t read(uint8_t address, uint8_t* data, size_t length);
+
+        HAL_I2C_RECEIVE onReceive = NULL;
+        HAL_I2C_REQUEST onRequest = NULL;
+
+    private:
+        uint8_t _bus = 0;
+        uint8_t _address = 0;
+};
+
+#pragma endregion i2c
+
+
+#pragma region camera
+
+// RGB565 as delivered by the camera: big endian, rows from top to bottom
+struct HAL_FRAME {
+    uint8_t* data;
+    uint16_t width;
+    uint16_t height;
+};
+
+// the frame stays valid until the next capture
+bool halCameraCapture(HAL_FRAME* frame);
+
+#pragma endregion camera
+
+
+#pragma region storage
+
+bool halStorageRead(uint16_t address, void* data, size_t length);
+bool halStorageWrite(uint16_t address, const void* data, size_t length);
+
+#pragma endregion storage
+
+
+#ifndef ARDUINO
+
+#pragma region native
+
+// inputs of the native backend
+void halNativeSetPin(uint8_t pin, bool state);  // calls attached interrupts on a matching edge
+bool halNativeGetPin(uint8_t pin);
+void halNativeSetPulse(uint8_t pin, uint32_t length);
+void halNativeSetAnalog(uint8_t pin, uint16_t value);
+
+// 24 bit BMP file as written by CAMERA::save, returned by every following capture
+bool halNativeCameraFile(const char* path);
+
+// storage is kept in this file, "hal_storage.bin" by default
+void halNativeStorageFile(const char* path);
+
+#pragma endregion native
+
+#endif
+
+#endif
@@ -0,0 +1,221 @@
+#ifdef ARDUINO
+
+#include "hal.h"
+#include <Arduino.h>
+#include <Wire.h>
+#include <EEPROM.h>
+
+#if defined(ESP32) && __has_include(<esp_camera.h>)
+    #include <esp_camera.h>
+    #define HAL_CAMERA
+#endif
+
+#ifdef ESP32
+    #define HAL_I2C_BUSES   2
+#else
+    #define HAL_I2C_BUSES   1
+#endif
+
+
+#pragma region timing
+
+uint32_t halMillis() {
+    return millis();
+}
+
+uint32_t halMicros() {
+    return micros();
+}
+
+void halDelay(uint32_t ms) {
+    delay(ms);
+}
+
+#pragma endregion timing
+
+
+#pragma region gpio
+
+void halPinMode(uint8_t pin, uint8_t mode) {
+    pinMode(pin, (mode == HAL_Output) ? OUTPUT : ((mode == HAL_Input_Pullup) ? INPUT_PULLUP : INPUT));
+}
+
+void halDigitalWrite(uint8_t pin, bool state) {
+    digitalWrite(pin, state ? HIGH : LOW);
+}
+
+bool halDigitalRead(uint8_t pin) {
+    return digitalRead(pin) == HIGH;
+}
+
+uint16_t halAnalogRead(uint8_t pin) {
+    return analogRead(pin);
+}
+
+uint32_t halPulseIn(uint8_t pin, bool state, uint32_t timeout) {
+    return pulseIn(pin, state ? HIGH : LOW, timeout);
+}
+
+bool halAttachInterrupt(uint8_t pin, void (*handler)(), uint8_t edge) {
+    int interrupt = digitalPinToInterrupt(pin);
+    if(interrupt == NOT_AN_INTERRUPT) return false;
+    attachInterrupt(interrupt, handler, (edge == HAL_Rising) ? RISING : ((edge == HAL_Falling) ? FALLING : CHANGE));
+    return true;
+}
+
+#pragma endregion gpio
+
+
+#pragma region i2c
+
+// Wire callbacks carry no context, so every bus has its own pair
+static HAL_I2C* slaves[HAL_I2C_BUSES] = {};
+
+static TwoWire* wire(uint8_t bus) {
+    #if HAL_I2C_BUSES > 1
+        return (bus == 1) ? &Wire1 : &Wire;
+    #else
+        return &Wire;
+    #endif
+}
+
+static void receive(uint8_t bus) {
+    uint8_t data[HAL_I2C_BUFFER_SIZE];
+    size_t length = 0;
+    while(wire(bus)->available() && (length < sizeof(data))) {
+        data[length++] = wire(bus)->read();
+    }
+    if(slaves[bus]->onReceive != NULL) {
+        slaves[bus]->onReceive(data, length);
+    }
+}
+
+static void request(uint8_t bus) {
+    uint8_t data[HAL_I2C_BUFFER_SIZE];
+    size_t length = (slaves[bus]->onRequest != NULL) ? slaves[bus]->onRequest(data, sizeof(data)) : 0;
+    wire(bus)->write(data, length);
+}
+
+static void receive0(int bytes) { receive(0); }
+static void request0() { request(0); }
+#if HAL_I2C_BUSES > 1
+    static void receive1(int bytes) { receive(1); }
+    static void request1() { request(1); }
+#endif
+
+HAL_I2C::HAL_I2C(uint8_t bus) {
+    _bus = (bus < HAL_I2C_BUSES) ? bus : 0;
+}
+
+bool HAL_I2C::beginMaster(uint8_t sda, uint8_t scl, uint32_t frequency) {
+    #ifdef ESP32
+        return wire(_bus)->begin(sda, scl, frequency);
+    #else
+        wire(_bus)->begin();
+        wire(_bus)->setClock(frequency);
+        return true;
+    #endif
+}
+
+bool HAL_I2C::beginSlave(uint8_t address, uint8_t sda, uint8_t scl, uint32_t frequency, HAL_I2C_RECEIVE onReceive, HAL_I2C_REQUEST onRequest) {
+    this->onReceive = onReceive;
+    this->onRequest = onRequest;
+    _address = address;
+    slaves[_bus] = this;
+    #if HAL_I2C_BUSES > 1
+        wire(_bus)->onReceive((_bus == 1) ? receive1 : receive0);
+        wire(_bus)->onRequest((_bus == 1) ? request1 : request0);
+    #else
+        wire(_bus)->onReceive(receive0);
+        wire(_bus)->onRequest(request0);
+    #endif
+    #ifdef ESP32
+        return wire(_bus)->begin(address, sda, scl, frequency);
+    #else
+        wire(_bus)->begin(address);
+        wire(_bus)->setClock(frequency);
+        return true;
+    #endif
+}
+
+bool HAL_I2C::write(uint8_t address, const uint8_t* data, size_t length) {
+    wire(_bus)->beginTransmission(address);
+    wire(_bus)->write(data, length);
+    return wire(_bus)->endTransmission() == 0;
+}
+
+size_t HAL_I2C::read(uint8_t address, uint8_t* data, size_t length) {
+    size_t received = wire(_bus)->requestFrom(address, (uint8_t)length);
+    for(size_t i = 0; i < received; i++) {
+        data[i] = wire(_bus)->read();
+    }
+    return received;
+}
+
+#pragma endregion i2c
+
+
+#pragma region camera
+
+#ifdef HAL_CAMERA
+    static camera_fb_t* frameBuffer = NULL;
+#endif
+
+bool halCameraCapture(HAL_FRAME* frame) {
+    #ifdef HAL_CAMERA
+        if(frameBuffer != NULL) {
+            esp_camera_fb_return(frameBuffer);
+        }
+        frameBuffer = esp_camera_fb_get();
+        if(frameBuffer == NULL) return false;
+        *frame = { frameBuffer->buf, (uint16_t)frameBuffer->width, (uint16_t)frameBuffer->height };
+        return true;
+    #else
+        return false;
+    #endif
+}
+
+#pragma endregion camera
+
+
+#pragma region storage
+
+// the ESP32 emulates the EEPROM in flash, it has to be mapped and committed
+static bool storageReady() {
+    #ifdef ESP32
+        static bool ready = false;
+        if(!ready) {
+            ready = EEPROM.begin(HAL_STORAGE_SIZE);
+        }
+        return ready;
+    #else
+        return true;
+    #endif
+}
+
+bool halStorageRead(uint16_t address, void* data, size_t length) {
+    if((address + length > HAL_STORAGE_SIZE) || !storageReady()) return false;
+    for(size_t i = 0; i < length; i++) {
+        ((uint8_t*)data)[i] = EEPROM.read(address + i);
+    }
+    return true;
+}
+
+bool halStorageWrite(uint16_t address, const void* data, size_t length) {
+    if((address + length > HAL_STORAGE_SIZE) || !storageReady()) return false;
+    for(size_t i = 0; i < length; i++) {
+        // unchanged cells are not rewritten, EEPROM cells wear out
+        if(EEPROM.read(address + i) != ((const uint8_t*)data)[i]) {
+            EEPROM.write(address + i, ((const uint8_t*)data)[i]);
+        }
+    }
+    #ifdef ESP32
+        return EEPROM.commit();
+    #else
+        return true;
+    #endif
+}
+
+#pragma endregion storage
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef ARDUINO
+
+#include "hal.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::recursive_mutex halMutex;
+
+
+#pragma region timing
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+uint32_t halMillis() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+uint32_t halMicros() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void halDelay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+#pragma endregion timing
+
+
+#pragma region gpio
+
+struct HAL_PIN {
+    uint8_t mode;
+    bool state;
+    uint16_t analog;
+    uint32_t pulse;
+    void (*handler)();
+    uint8_t edge;
+};
+
+static HAL_PIN pins[256] = {};
+
+void halPinMode(uint8_t pin, uint8_t mode) {
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    pins[pin].mode = mode;
+    if(mode == HAL_Input_Pullup) {
+        pins[pin].state = true;
+    }
+}
+
+void halDigitalWrite(uint8_t pin, bool state) {
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    pins[pin].state = state;
+}
+
+bool halDigitalRead(uint8_t pin) {
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    return pins[pin].state;
+}
+
+uint16_t halAnalogRead(uint8_t pin) {
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    return pins[pin].analog;
+}
+
+// echoes do not take time, the host program sets them before the measurement
+uint32_t halPulseIn(uint8_t pin, bool state, uint32_t timeout) {
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    return (pins[pin].pulse <= timeout) ? pins[pin].pulse : 0;
+}
+
+bool halAttachInterrupt(uint8_t pin, void (*handler)(), uint8_t edge) {
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    pins[pin].handler = handler;
+    pins[pin].edge = edge;
+    return true;
+}
+
+void halNativeSetPin(uint8_t pin, bool state) {
+    void (*handler)() = NULL;
+    {
+        std::lock_guard<std::recursive_mutex> lock(halMutex);
+        bool previous = pins[pin].state;
+        pins[pin].state = state;
+        if((previous != state) && ((pins[pin].edge == HAL_Change) || ((pins[pin].edge == HAL_Rising) == state))) {
+            handler = pins[pin].handler;
+        }
+    }
+    if(handler != NULL) {
+        handler();
+    }
+}
+
+bool halNativeGetPin(uint8_t pin) {
+    return halDigitalRead(pin);
+}
+
+void halNativeSetPulse(uint8_t pin, uint32_t length) {
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    pins[pin].pulse = length;
+}
+
+void halNativeSetAnalog(uint8_t pin, uint16_t value) {
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    pins[pin].analog = value;
+}
+
+#pragma endregion gpio
+
+
+#pragma region i2c
+
+// masters and slaves of the same bus number in this process are connected
+struct HAL_I2C_SLAVE {
+    uint8_t bus;
+    uint8_t address;
+    HAL_I2C* i2c;
+};
+
+static std::vector<HAL_I2C_SLAVE> slaves;
+
+static HAL_I2C* findSlave(uint8_t bus, uint8_t address) {
+    for(const HAL_I2C_SLAVE& slave : slaves) {
+        if((slave.bus == bus) && (slave.address == address)) return slave.i2c;
+    }
+    return NULL;
+}
+
+HAL_I2C::HAL_I2C(uint8_t bus) {
+    _bus = bus;
+}
+
+bool HAL_I2C::beginMaster(uint8_t sda, uint8_t scl, uint32_t frequency) {
+    return true;
+}
+
+bool HAL_I2C::beginSlave(uint8_t address, uint8_t sda, uint8_t scl, uint32_t frequency, HAL_I2C_RECEIVE onReceive, HAL_I2C_REQUEST onRequest) {
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    if(findSlave(_bus, address) != NULL) return false;
+    this->onReceive = onReceive;
+    this->onRequest = onRequest;
+    _address = address;
+    slaves.push_back({ _bus, address, this });
+    return true;
+}
+
+bool HAL_I2C::write(uint8_t address, const uint8_t* data, size_t length) {
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    HAL_I2C* slave = findSlave(_bus, address);
+    if((slave == NULL) || (length > HAL_I2C_BUFFER_SIZE)) return false;
+    if(slave->onReceive != NULL) {
+        slave->onReceive(data, length);
+    }
+    return true;
+}
+
+size_t HAL_I2C::read(uint8_t address, uint8_t* data, size_t length) {
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    HAL_I2C* slave = findSlave(_bus, address);
+    if((slave == NULL) || (slave->onRequest == NULL)) return 0;
+    uint8_t answer[HAL_I2C_BUFFER_SIZE];
+    size_t answered = slave->onRequest(answer, sizeof(answer));
+    // the master clocks out as many bytes as it asked for
+    size_t received = (length < HAL_I2C_BUFFER_SIZE) ? length : HAL_I2C_BUFFER_SIZE;
+    for(size_t i = 0; i < received; i++) {
+        data[i] = (i < answered) ? answer[i] : 0xFF;
+    }
+    return received;
+}
+
+#pragma endregion i2c
+
+
+#pragma region camera
+
+static std::vector<uint8_t> image;
+static std::vector<uint8_t> frameBuffer;
+static uint16_t imageWidth = 0;
+static uint16_t imageHeight = 0;
+
+template<typename T> static T readLittleEndian(const uint8_t* data) {
+    T value = 0;
+    for(size_t i = 0; i < sizeof(T); i++) {
+        value |= (T)data[i] << (8 * i);
+    }
+    return value;
+}
+
+// rows are kept in file order, a file written by CAMERA::save gives back the captured frame
+bool halNativeCameraFile(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if(file == NULL) return false;
+    uint8_t header[54];
+    bool valid = (fread(header, 1, sizeof(header), file) == sizeof(header)) && (header[0] == 'B') && (header[1] == 'M');
+    uint32_t offset = valid ? readLittleEndian<uint32_t>(header + 10) : 0;
+    int32_t width = valid ? readLittleEndian<int32_t>(header + 18) : 0;
+    int32_t height = valid ? readLittleEndian<int32_t>(header + 22) : 0;
+    height = (height < 0) ? -height : height;
+    valid = valid && (readLittleEndian<uint16_t>(header + 28) == 24) && (readLittleEndian<uint32_t>(header + 30) == 0)
+            && (width > 0) && (width <= 0xFFFF) && (height > 0) && (height <= 0xFFFF) && (fseek(file, offset, SEEK_SET) == 0);
+    std::vector<uint8_t> pixels(valid ? (size_t)width * height * 2 : 0);
+    std::vector<uint8_t> row(((size_t)width * 3 + 3) & ~(size_t)3);
+    for(int32_t y = 0; valid && (y < height); y++) {
+        valid = fread(row.data(), 1, row.size(), file) == row.size();
+        for(int32_t x = 0; valid && (x < width); x++) {
+            uint8_t b = row[x * 3];
+            uint8_t g = row[x * 3 + 1];
+            uint8_t r = row[x * 3 + 2];
+            uint16_t pixel = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+            pixels[((size_t)y * width + x) * 2] = pixel >> 8;
+            pixels[((size_t)y * width + x) * 2 + 1] = pixel & 0xFF;
+        }
+    }
+    fclose(file);
+    if(!valid) return false;
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    image.swap(pixels);
+    imageWidth = width;
+    imageHeight = height;
+    return true;
+}
+
+// every capture starts from a fresh copy, the firmware corrects frames in place
+bool halCameraCapture(HAL_FRAME* frame) {
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    if(image.empty()) return false;
+    frameBuffer = image;
+    *frame = { frameBuffer.data(), imageWidth, imageHeight };
+    return true;
+}
+
+#pragma endregion camera
+
+
+#pragma region storage
+
+static std::string storagePath = "hal_storage.bin";
+
+void halNativeStorageFile(const char* path) {
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    storagePath = path;
+}
+
+// an erased EEPROM reads 0xFF
+static void loadStorage(uint8_t* storage) {
+    memset(storage, 0xFF, HAL_STORAGE_SIZE);
+    FILE* file = fopen(storagePath.c_str(), "rb");
+    if(file == NULL) return;
+    size_t length = fread(storage, 1, HAL_STORAGE_SIZE, file);
+    (void)length;
+    fclose(file);
+}
+
+bool halStorageRead(uint16_t address, void* data, size_t length) {
+    if(address + length > HAL_STORAGE_SIZE) return false;
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    uint8_t storage[HAL_STORAGE_SIZE];
+    loadStorage(storage);
+    memcpy(data, storage + address, length);
+    return true;
+}
+
+bool halStorageWrite(uint16_t address, const void* data, size_t length) {
+    if(address + length > HAL_STORAGE_SIZE) return false;
+    std::lock_guard<std::recursive_mutex> lock(halMutex);
+    uint8_t storage[HAL_STORAGE_SIZE];
+    loadStorage(storage);
+    memcpy(storage + address, data, length);
+    FILE* file = fopen(storagePath.c_str(), "wb");
+    if(file == NULL) return false;
+    bool written = fwrite(storage, 1, HAL_STORAGE_SIZE, file) == HAL_STORAGE_SIZE;
+    return (fclose(file) == 0) && written;
+}
+
+#pragma endregion storage
+
+#endif
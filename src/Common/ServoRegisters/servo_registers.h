@@ -0,0 +1,50 @@
+#ifndef SERVO_REGISTERS_H
+#define SERVO_REGISTERS_H
+
+/**
+ * Register map of the WRO Servo board
+ * shared by WRO Main and WRO Servo
+ * by TerraForce
+ *
+ * A write transaction starts with a register address, the following bytes fill the
+ * registers from there on with auto increment. The board applies a transaction as a whole,
+ * so all servo targets and lights of a control tick change together.
+ * A read answers the sensor registers from the last written address on, so a write of the
+ * address alone followed by a repeated start reads only the registers needed.
+*/
+
+#define SERVO_REGISTERS_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+
+#define SERVO_BOARD_ADDRESS     0x50
+#define SERVO_CHANNELS          4
+#define SERVO_LIGHTS            8
+
+enum SERVO_REGISTER_ADDRESSES {
+    SERVO_Reg_Targets       = 0x00,     // int16 per channel, little endian
+    SERVO_Reg_Lights        = 0x08,
+    SERVO_Reg_Write_End     = 0x09,
+
+    SERVO_Reg_Analog        = 0x10,     // uint16 per ADC channel, read only
+    SERVO_Reg_Battery       = 0x10,     // first ADC channel
+    SERVO_Reg_Motor_Turns   = 0x18,     // int32 per encoder, read only
+    SERVO_Reg_Motor_Rpm     = 0x20,     // int16 per encoder, read only
+    SERVO_Reg_Read_End      = 0x24
+};
+
+struct SERVO_WRITE_REGISTERS {
+    int16_t targets[SERVO_CHANNELS];    // servo angles in 1/10 degrees, -900 to 900
+    uint8_t lights;                     // bit i switches LED i
+} __attribute__((packed));
+
+struct SERVO_READ_REGISTERS {
+    uint16_t analogValues[4];           // 12 bit resolution in 5V
+    int32_t motorTurns[2];              // 1/8 motor turns, counting down backwards with ENCODER_QUADRATURE on WRO Servo
+    int16_t motorRpm[2];                // of the last encoder period, 0 when standing
+} __attribute__((packed));
+
+static_assert(sizeof(SERVO_WRITE_REGISTERS) == SERVO_Reg_Write_End, "register map and struct differ");
+static_assert(sizeof(SERVO_READ_REGISTERS) == SERVO_Reg_Read_End - SERVO_Reg_Analog, "register map and struct differ");
+
+#endif
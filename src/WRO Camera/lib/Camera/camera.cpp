@@ -67,6 +67,19 @@ CAMERA::RGBROW::RGBPIXEL CAMERA::RGBROW::operator[](uint16_t y) {
     return CAMERA::RGBROW::RGBPIXEL(_rowStart, _x, y, _width, _height);
 }
 
+bool CAMERA::capture() {
+    HAL_FRAME frame;
+    if(!halCameraCapture(&frame)) {
+        return false;
+    }
+    _frame = frame.data;
+    height = frame.height;
+    width = frame.width;
+    return true;
+}
+
+#ifdef ARDUINO
+
 bool CAMERA::init(FrameSize frameSize) {
     camera_config_t camera_config = {
         .pin_pwdn = CAM_PIN_PWDN,
@@ -104,17 +117,6 @@ bool CAMERA::init(FrameSize frameSize) {
     return true;
 }
 
-bool CAMERA::capture() {
-    esp_camera_fb_return(frameBuffer);
-    frameBuffer = esp_camera_fb_get();
-    if(!frameBuffer) {
-        return false;
-    }
-    height = frameBuffer->height;
-    width = frameBuffer->width;
-    return true;
-}
-
 bool CAMERA::save(File* file) {
     BMP_HEADER bmpHeader = {};
     bmpHeader.bfSize = 54 + (3 * width * height);
@@ -130,7 +132,7 @@ bool CAMERA::save(File* file) {
     file->write((uint8_t*)(&bmpHeader), sizeof(BMP_HEADER));
     for(uint16_t lines = 0; lines < height; lines++) {
         uint8_t colorBuffer[width * 3];
-        fmt2rgb888(frameBuffer->buf + (lines * width * 2), width * 2, PIXFORMAT_RGB565, colorBuffer);
+        fmt2rgb888(_frame + (lines * width * 2), width * 2, PIXFORMAT_RGB565, colorBuffer);
         file->write(colorBuffer, sizeof(colorBuffer));
     }
     file->close();
@@ -153,7 +155,7 @@ bool CAMERA::save(File* file) {
     client.write((uint8_t*)(&bmpHeader), sizeof(BMP_HEADER));
     for(uint16_t lines = 0; lines < height; lines++) {
         uint8_t colorBuffer[width * 3];
-        fmt2rgb888(frameBuffer->buf + (lines * width * 2), width * 2, PIXFORMAT_RGB565, colorBuffer);
+        fmt2rgb888(_frame + (lines * width * 2), width * 2, PIXFORMAT_RGB565, colorBuffer);
         client.write(colorBuffer, sizeof(colorBuffer));
     }
     client.stop();
@@ -165,6 +167,8 @@ void CAMERA::setContrast    (uint8_t level) {sensor->set_contrast   (sensor, lev
 void CAMERA::setSaturation  (uint8_t level) {sensor->set_saturation (sensor, level);}
 void CAMERA::setSharpness   (uint8_t level) {sensor->set_sharpness  (sensor, level);}
 
+#endif
+
 CAMERA::RGBROW CAMERA::operator[](uint16_t x) {
-    return CAMERA::RGBROW(frameBuffer->buf, x, width, height);
+    return CAMERA::RGBROW(_frame, x, width, height);
 }
@@ -6,10 +6,15 @@
  * by TerraForce
 */
 
-#include <Arduino.h>
-#include <esp_camera.h>
-#include <FS.h>
-//#include <WiFi.h>
+#include <stdint.h>
+#include "hal.h"
+
+#ifdef ARDUINO
+    #include <Arduino.h>
+    #include <esp_camera.h>
+    #include <FS.h>
+    //#include <WiFi.h>
+#endif
 
 #define CAM_PIN_PWDN 32
 #define CAM_PIN_RESET -1 //software reset will be performed
@@ -123,15 +128,17 @@ class CAMERA {
         };
 
         // Functions
-        bool init(FrameSize frameSize);
+        #ifdef ARDUINO
+            bool init(FrameSize frameSize);
+            bool save(File* file);
+            //bool send(WiFiClient client);
+
+            void setBrightness(uint8_t level);  // -2 - 2
+            void setContrast(uint8_t level);    // -2 - 2
+            void setSaturation(uint8_t level);  // -2 - 2
+            void setSharpness(uint8_t level);   // -2 - 2
+        #endif
         bool capture();
-        bool save(File* file);
-        //bool send(WiFiClient client);
-
-        void setBrightness(uint8_t level);  // -2 - 2
-        void setContrast(uint8_t level);    // -2 - 2
-        void setSaturation(uint8_t level);  // -2 - 2
-        void setSharpness(uint8_t level);   // -2 - 2
 
         RGBROW operator[](uint16_t x);
 
@@ -140,9 +147,11 @@ class CAMERA {
         uint16_t width = 0;
 
     private:
-        sensor_t* sensor;
-        camera_sensor_info_t* _settings;
-        camera_fb_t* frameBuffer;
+        #ifdef ARDUINO
+            sensor_t* sensor;
+            camera_sensor_info_t* _settings;
+        #endif
+        uint8_t* _frame = NULL;
 };
 
 #endif
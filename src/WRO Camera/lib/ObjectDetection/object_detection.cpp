@@ -0,0 +1,72 @@
+#include "object_detection.h"
+
+uint32_t correctImage(CAMERA& camera) {
+	uint32_t averageR = 0, averageG = 0, averageB = 0;
+	for (uint16_t x = 0; x < camera.width; x += Image_Density_Horizontal) {
+		for (uint16_t y = camera.height * Image_Upper_Height; y < camera.height * Image_Lower_Height; y += Image_Density_Vertical) {
+			averageR += camera[x][y].r();
+			averageG += camera[x][y].g();
+			averageB += camera[x][y].b();
+		}
+	}
+    uint32_t pixelCount = (uint32_t)(camera.width * camera.height * (Image_Lower_Height - Image_Upper_Height) / (Image_Density_Horizontal * Image_Density_Vertical));
+	averageR = (uint32_t)(averageR / (double)pixelCount);
+	averageG = (uint32_t)(averageG / (double)pixelCount);
+	averageB = (uint32_t)(averageB / (double)pixelCount);
+    uint16_t averageMin = MIN3(averageR, averageG, averageB);
+	int16_t correctionR = (int16_t)(((averageR - averageMin) * Image_Color_Correction_Strength) + ((averageMin - Image_Average_Brightness) * Image_Brightness_Correction_Strength));
+	int16_t correctionG = (int16_t)(((averageG - averageMin) * Image_Color_Correction_Strength) + ((averageMin - Image_Average_Brightness) * Image_Brightness_Correction_Strength));
+    int16_t correctionB = (int16_t)(((averageB - averageMin) * Image_Color_Correction_Strength) + ((averageMin - Image_Average_Brightness) * Image_Brightness_Correction_Strength));
+	for (uint16_t x = 0; x < camera.width; x += Image_Density_Horizontal) {
+		for (uint16_t y = camera.height * Image_Upper_Height; y < camera.height * Image_Lower_Height; y += Image_Density_Vertical) {
+			camera[x][y].r() = MIN2(MAX2(camera[x][y].r() - correctionR, 0), 255);
+            camera[x][y].g() = MIN2(MAX2(camera[x][y].g() - correctionG, 0), 255);
+            camera[x][y].b() = MIN2(MAX2(camera[x][y].b() - correctionB, 0), 255);
+		}
+	}
+    return pixelCount;
+}
+
+DETECTED_OBJECT detectObject(CAMERA& camera) {
+    DETECTED_OBJECT object = {};
+    uint16_t PixelX = 0;
+    uint16_t PixelY = camera.height * Image_Lower_Height;
+	
+	while (((camera[camera.width / 2][PixelY].r() > Image_Black_Value_R) || (camera[camera.width / 2][PixelY].g() > Image_Black_Value_G) || (camera[camera.width / 2][PixelY].b() > Image_Black_Value_B)) && (PixelY >= camera.height * Image_Upper_Height)) {
+		PixelX = camera.width / 2;
+		while ((camera[PixelX][PixelY].r() > Image_Black_Value_R) && (camera[PixelX][PixelY].g() > Image_Black_Value_G) && (camera[PixelX][PixelY].b() > Image_Black_Value_B) && PixelX > 200) {
+			if ((camera[PixelX][PixelY].r() > camera[PixelX][PixelY].g() * Image_Red_Ratio) && (camera[PixelX][PixelY].r() > camera[PixelX][PixelY].b() * Image_Red_Ratio) && (camera[PixelX][PixelY].r() > Image_Min_Red_Value)) {
+				object.available = true;
+				object.color = Red;
+				goto ImageAnalysisEnd;
+			}
+			if ((camera[PixelX][PixelY].g() > camera[PixelX][PixelY].r() + 30) && (camera[PixelX][PixelY].g() < camera[PixelX][PixelY].r() + 120) && (camera[PixelX][PixelY].g() > camera[PixelX][PixelY].b() * Image_Green_Ratio) && (camera[PixelX][PixelY].g() > Image_Min_Green_Value)) {
+				object.available = true;
+				object.color = Green;
+				goto ImageAnalysisEnd;
+			}
+			PixelX -= Image_Density_Horizontal;
+		}
+		PixelX = camera.width / 2;
+		while ((camera[PixelX][PixelY].r() > Image_Black_Value_R) && (camera[PixelX][PixelY].g() > Image_Black_Value_G) && (camera[PixelX][PixelY].b() > Image_Black_Value_B) && (PixelX < camera.width -200)) {
+			if ((camera[PixelX][PixelY].r() > camera[PixelX][PixelY].g() * Image_Red_Ratio) && (camera[PixelX][PixelY].r() > camera[PixelX][PixelY].b() * Image_Red_Ratio) && (camera[PixelX][PixelY].r() > Image_Min_Red_Value)) {
+				object.available = true;
+				object.color = Red;
+				goto ImageAnalysisEnd;
+			}
+			if ((camera[PixelX][PixelY].g() > camera[PixelX][PixelY].r() + 30) && (camera[PixelX][PixelY].g() < camera[PixelX][PixelY].r() + 120) && (camera[PixelX][PixelY].g() > camera[PixelX][PixelY].b() * Image_Green_Ratio) && (camera[PixelX][PixelY].g() > Image_Min_Green_Value)) {
+				object.available = true;
+				object.color = Green;
+				goto ImageAnalysisEnd;
+			}
+			PixelX += Image_Density_Horizontal;
+		}
+		PixelY -= Image_Density_Vertical;
+	}
+	ImageAnalysisEnd:
+    object.direction = PixelX > camera.width / 2;
+    object.angle = (uint8_t)(((((camera.width / 2) - PixelX) > 0 ? ((camera.width / 2) - PixelX) : -((camera.width / 2) - PixelX)) / (camera.width / 2.0)) * 0x1F);
+    object.x = PixelX;
+    object.y = PixelY;
+    return object;
+}
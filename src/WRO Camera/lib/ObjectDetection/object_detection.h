@@ -0,0 +1,60 @@
+#ifndef OBJECT_DETECTION_H
+#define OBJECT_DETECTION_H
+
+/**
+ * Object detection library for the pillars of the obstacle course
+ * by TerraForce
+*/
+
+#define OBJECT_DETECTION_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+#include "camera.h"
+
+#define MAX2(a, b) ((a) > (b) ? (a) : (b))
+#define MAX3(a, b, c) (MAX2(MAX2(a, b), c))
+#define MIN2(a, b) ((a) < (b) ? (a) : (b))
+#define MIN3(a, b, c) (MIN2(MIN2(a, b), c))
+
+// image processing parameters
+#define Image_Upper_Height          0.4
+#define Image_Lower_Height          0.8
+#define Image_Density_Horizontal    20
+#define Image_Density_Vertical      20
+
+// image correction parameters
+#define Image_Average_Brightness                175
+#define Image_Brightness_Correction_Strength    1.0
+#define Image_Color_Correction_Strength         0.5
+
+// image analysis parameters
+#define Image_Black_Value_R         40
+#define Image_Black_Value_G         40
+#define Image_Black_Value_B         40
+#define Image_Min_Red_Value         60
+#define Image_Min_Green_Value       60
+#define Image_Max_Green_Value       200
+#define Image_Red_Ratio             1.4
+#define Image_Green_Ratio           1.6
+
+enum ObjectColors {
+    Green,
+    Red
+};
+
+struct DETECTED_OBJECT {
+    bool available;
+    uint8_t color;
+    bool direction;     // right of the image center
+    uint8_t angle;      // distance to the image center, 0x1F at the image border
+    uint16_t x;         // target pixel, the last one scanned if no object was found
+    uint16_t y;
+};
+
+// corrects brightness and color cast of the sampled pixels in place, returns the number of sampled pixels
+uint32_t correctImage(CAMERA& camera);
+
+// scans the corrected pixels from the center outwards, row by row up to the black border
+DETECTED_OBJECT detectObject(CAMERA& camera);
+
+#endif
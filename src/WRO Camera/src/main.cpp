@@ -5,32 +5,6 @@
 
 #define WRO_CAMERA_VERSION "1.3.0"
 
-#define MAX2(a, b) ((a) > (b) ? (a) : (b))
-#define MAX3(a, b, c) (MAX2(MAX2(a, b), c))
-#define MIN2(a, b) ((a) < (b) ? (a) : (b))
-#define MIN3(a, b, c) (MIN2(MIN2(a, b), c))
-
-// image processing parameters
-#define Image_Upper_Height          0.4
-#define Image_Lower_Height          0.8
-#define Image_Density_Horizontal    20
-#define Image_Density_Vertical      20
-
-// image correction parameters
-#define Image_Average_Brightness                175
-#define Image_Brightness_Correction_Strength    1.0
-#define Image_Color_Correction_Strength         0.5
-
-// image analysis parameters
-#define Image_Black_Value_R         40
-#define Image_Black_Value_G         40
-#define Image_Black_Value_B         40
-#define Image_Min_Red_Value         60
-#define Image_Min_Green_Value       60
-#define Image_Max_Green_Value       200
-#define Image_Red_Ratio             1.4
-#define Image_Green_Ratio           1.6
-
 // serial debug
 // #define SERIAL_DEBUG
 
@@ -41,10 +15,15 @@
 // saves image (after correction) on sd card
 // #define SAVE_IMAGE_SD_CARD
 
+// interval of the health message to WRO Main in ms
+#define Health_Message_Interval     1000
+
 #pragma region includes
 
 #include <Arduino.h>
+#include "hal.h"
 #include "camera.h"
+#include "object_detection.h"
 
 #ifdef SERIAL_DEBUG
     #include <HardwareSerial.h>
@@ -54,6 +33,7 @@
     #include <SD_MMC.h>
 #else
     #include <Wire.h>
+    #include "camera_link.h"
     #include "MPU6050.h"
 #endif
 
@@ -73,11 +53,6 @@
 
 #pragma region global_properties
 
-enum ObjectColors {
-    Green,
-    Red
-};
-
 enum ObjectDirections {
     Left,
     Right
@@ -94,7 +69,13 @@ struct CAMERA_SENSOR_DATA {
 } cameraSensorData = {};
 
 #ifndef SAVE_IMAGE_SD_CARD
-    TwoWire i2c_master(0);
+    // bus 0 is Wire, the MPU6050 task shares it
+    HAL_I2C i2c_master(0);
+    CAMERA_LINK cameraLink;
+    uint16_t sendFailures = 0;
+    uint16_t frameTime = 0;
+    uint8_t cameraErrors = 0;
+    uint32_t lastHealthMessage = 0;
     bool interruptWorking = false;
 #else
     uint32_t ImageCount = 0;
@@ -114,7 +95,10 @@ CAMERA camera;
 void ImageAnalysis();
 
 #ifndef SAVE_IMAGE_SD_CARD
-    void i2cSendData();
+    void i2cSendMessage(uint8_t type, const void* payload, uint8_t length);
+    void i2cSendHeading();
+    void i2cSendObstacles();
+    void i2cSendHealth();
 #endif
 
 #pragma endregion functions
@@ -132,12 +116,12 @@ void setup() {
 
     #ifndef SAVE_IMAGE_SD_CARD
         // start I2C as master in fast mode
-        i2c_master.begin(Pin_I2C_MASTER_SDA, Pin_I2C_MASTER_SCL, 400000);
+        i2c_master.beginMaster(Pin_I2C_MASTER_SDA, Pin_I2C_MASTER_SCL, 400000);
     #endif
 
     // disable onboard LED
-    pinMode(4, OUTPUT);
-    digitalWrite(4, LOW);
+    halPinMode(4, HAL_Output);
+    halDigitalWrite(4, false);
 
     // start camera and PSRAM
     psramInit();
@@ -150,7 +134,7 @@ void setup() {
 
     #ifndef SAVE_IMAGE_SD_CARD
         // start MPU6050
-        mpu6050.init(&i2c_master, 0x68, (uint8_t)(1 << Rotation_Z), 1 - xPortGetCoreID());
+        mpu6050.init(&Wire, 0x68, (uint8_t)(1 << Rotation_Z), 1 - xPortGetCoreID());
     #endif
 }
 
@@ -160,22 +144,32 @@ void setup() {
 #pragma region loop
 
 void loop() {
-    camera.capture();
+    uint32_t frameStart = halMillis();
+    bool captured = camera.capture();
 
     #ifndef SAVE_IMAGE_SD_CARD
-        i2cSendData();
+        i2cSendHeading();
     #endif
 
-    ImageAnalysis();
+    // a failed capture leaves no valid frame to analyse
+    if(captured) {
+        ImageAnalysis();
+    }
 
     #ifndef SAVE_IMAGE_SD_CARD
-        i2cSendData();
+        i2cSendHeading();
+
+        frameTime = halMillis() - frameStart;
+        cameraErrors = captured ? (cameraErrors & ~CAMERA_Capture_Failed) : (cameraErrors | CAMERA_Capture_Failed);
+        if(halMillis() >= lastHealthMessage + Health_Message_Interval) {
+            i2cSendHealth();
+            lastHealthMessage = halMillis();
+        }
 
         #ifdef DEBUG_I2C_SCAN
             loggingSerial.println("Scanning for I2C devices ...");
             for(uint8_t i = 1; i < 0x7f; i++) {
-                i2c_master.beginTransmission(i);
-                if(i2c_master.endTransmission() == 0) {
+                if(i2c_master.write(i, NULL, 0)) {
                     loggingSerial.print("I2C device found on address ");
                     loggingSerial.println(i, HEX);
                 }
@@ -183,7 +177,7 @@ void loop() {
             loggingSerial.println("done.\n");
         #endif
     #endif
-    delay(50);
+    halDelay(50);
 }
 
 #pragma endregion loop
@@ -192,31 +186,9 @@ void loop() {
 #pragma region functions
 
 void ImageAnalysis() {
-	uint32_t averageR = 0, averageG = 0, averageB = 0;
-	for (uint16_t x = 0; x < camera.width; x += Image_Density_Horizontal) {
-		for (uint16_t y = camera.height * Image_Upper_Height; y < camera.height * Image_Lower_Height; y += Image_Density_Vertical) {
-			averageR += camera[x][y].r();
-			averageG += camera[x][y].g();
-			averageB += camera[x][y].b();
-		}
-	}
-    uint32_t pixelCount = (uint32_t)(camera.width * camera.height * (Image_Lower_Height - Image_Upper_Height) / (Image_Density_Horizontal * Image_Density_Vertical));
-	averageR = (uint32_t)(averageR / (double)pixelCount);
-	averageG = (uint32_t)(averageG / (double)pixelCount);
-	averageB = (uint32_t)(averageB / (double)pixelCount);
-    uint16_t averageMin = MIN3(averageR, averageG, averageB);
-	int16_t correctionR = (int16_t)(((averageR - averageMin) * Image_Color_Correction_Strength) + ((averageMin - Image_Average_Brightness) * Image_Brightness_Correction_Strength));
-	int16_t correctionG = (int16_t)(((averageG - averageMin) * Image_Color_Correction_Strength) + ((averageMin - Image_Average_Brightness) * Image_Brightness_Correction_Strength));
-    int16_t correctionB = (int16_t)(((averageB - averageMin) * Image_Color_Correction_Strength) + ((averageMin - Image_Average_Brightness) * Image_Brightness_Correction_Strength));
-	for (uint16_t x = 0; x < camera.width; x += Image_Density_Horizontal) {
-		for (uint16_t y = camera.height * Image_Upper_Height; y < camera.height * Image_Lower_Height; y += Image_Density_Vertical) {
-			camera[x][y].r() = MIN2(MAX2(camera[x][y].r() - correctionR, 0), 255);
-            camera[x][y].g() = MIN2(MAX2(camera[x][y].g() - correctionG, 0), 255);
-            camera[x][y].b() = MIN2(MAX2(camera[x][y].b() - correctionB, 0), 255);
-		}
-	}
-
     #ifdef SAVE_IMAGE_SD_CARD
+        uint32_t pixelCount = correctImage(camera);
+
         if(!SD_MMC.exists("/esp-cam-images")) {
             SD_MMC.mkdir("/esp-cam-images");
         }
@@ -244,64 +216,32 @@ void ImageAnalysis() {
             }
         }
         file.close();
+    #else
+        correctImage(camera);
+        i2cSendHeading();
     #endif
 
+    DETECTED_OBJECT object = detectObject(camera);
+    cameraSensorData.object.available = object.available;
+    cameraSensorData.object.color = object.color;
+    cameraSensorData.object.direction = object.direction;
+    cameraSensorData.object.angle = object.angle;
+
     #ifndef SAVE_IMAGE_SD_CARD
-        i2cSendData();
+        i2cSendObstacles();
     #endif
-
-    uint16_t PixelX = 0;
-    uint16_t PixelY = camera.height * Image_Lower_Height;
-
-    cameraSensorData.object.available = false;
-    cameraSensorData.object.color = 0;
-	
-	while (((camera[camera.width / 2][PixelY].r() > Image_Black_Value_R) || (camera[camera.width / 2][PixelY].g() > Image_Black_Value_G) || (camera[camera.width / 2][PixelY].b() > Image_Black_Value_B)) && (PixelY >= camera.height * Image_Upper_Height)) {
-		PixelX = camera.width / 2;
-		while ((camera[PixelX][PixelY].r() > Image_Black_Value_R) && (camera[PixelX][PixelY].g() > Image_Black_Value_G) && (camera[PixelX][PixelY].b() > Image_Black_Value_B) && PixelX > 200) {
-			if ((camera[PixelX][PixelY].r() > camera[PixelX][PixelY].g() * Image_Red_Ratio) && (camera[PixelX][PixelY].r() > camera[PixelX][PixelY].b() * Image_Red_Ratio) && (camera[PixelX][PixelY].r() > Image_Min_Red_Value)) {
-				cameraSensorData.object.available = true;
-				cameraSensorData.object.color = Red;
-				goto ImageAnalysisEnd;
-			}
-			if ((camera[PixelX][PixelY].g() > camera[PixelX][PixelY].r() + 30) && (camera[PixelX][PixelY].g() < camera[PixelX][PixelY].r() + 120) && (camera[PixelX][PixelY].g() > camera[PixelX][PixelY].b() * Image_Green_Ratio) && (camera[PixelX][PixelY].g() > Image_Min_Green_Value)) {
-				cameraSensorData.object.available = true;
-				cameraSensorData.object.color = Green;
-				goto ImageAnalysisEnd;
-			}
-			PixelX -= Image_Density_Horizontal;
-		}
-		PixelX = camera.width / 2;
-		while ((camera[PixelX][PixelY].r() > Image_Black_Value_R) && (camera[PixelX][PixelY].g() > Image_Black_Value_G) && (camera[PixelX][PixelY].b() > Image_Black_Value_B) && (PixelX < camera.width -200)) {
-			if ((camera[PixelX][PixelY].r() > camera[PixelX][PixelY].g() * Image_Red_Ratio) && (camera[PixelX][PixelY].r() > camera[PixelX][PixelY].b() * Image_Red_Ratio) && (camera[PixelX][PixelY].r() > Image_Min_Red_Value)) {
-				cameraSensorData.object.available = true;
-				cameraSensorData.object.color = Red;
-				goto ImageAnalysisEnd;
-			}
-			if ((camera[PixelX][PixelY].g() > camera[PixelX][PixelY].r() + 30) && (camera[PixelX][PixelY].g() < camera[PixelX][PixelY].r() + 120) && (camera[PixelX][PixelY].g() > camera[PixelX][PixelY].b() * Image_Green_Ratio) && (camera[PixelX][PixelY].g() > Image_Min_Green_Value)) {
-				cameraSensorData.object.available = true;
-				cameraSensorData.object.color = Green;
-				goto ImageAnalysisEnd;
-			}
-			PixelX += Image_Density_Horizontal;
-		}
-		PixelY -= Image_Density_Vertical;
-	}
-	ImageAnalysisEnd:
-    cameraSensorData.object.direction = PixelX > camera.width / 2;
-    cameraSensorData.object.angle = (uint8_t)(((((camera.width / 2) - PixelX) > 0 ? ((camera.width / 2) - PixelX) : -((camera.width / 2) - PixelX)) / (camera.width / 2.0)) * 0x1F);
     
     #ifdef SERIAL_DEBUG
         loggingSerial.print("Target pixel:\nx: ");
-        loggingSerial.println(PixelX);
+        loggingSerial.println(object.x);
         loggingSerial.print("y: ");
-        loggingSerial.println(PixelY);
+        loggingSerial.println(object.y);
         loggingSerial.print("r: ");
-        loggingSerial.println(camera[PixelX][PixelY].r());
+        loggingSerial.println(camera[object.x][object.y].r());
         loggingSerial.print("g: ");
-        loggingSerial.println(camera[PixelX][PixelY].g());
+        loggingSerial.println(camera[object.x][object.y].g());
         loggingSerial.print("b: ");
-        loggingSerial.println(camera[PixelX][PixelY].b());
+        loggingSerial.println(camera[object.x][object.y].b());
 
         if(cameraSensorData.object.available) {
             if(cameraSensorData.object.color) {
@@ -324,16 +264,37 @@ void ImageAnalysis() {
 }
 
 #ifndef SAVE_IMAGE_SD_CARD
-    void i2cSendData() {
+    void i2cSendMessage(uint8_t type, const void* payload, uint8_t length) {
+        uint8_t message[CAMERA_LINK_MAX_MESSAGE];
+        if(!i2c_master.write(0x51, message, cameraLink.encode(type, payload, length, message))) {
+            sendFailures++;
+        }
+    }
+
+    void i2cSendHeading() {
         cameraSensorData.rotation = (int32_t)(mpu6050.data[Rotation_Z] * (-10.0));
-        i2c_master.beginTransmission(0x51);
-        i2c_master.write((uint8_t*)&cameraSensorData, sizeof(CAMERA_SENSOR_DATA));
-        i2c_master.endTransmission();
+        CAMERA_HEADING heading = { cameraSensorData.rotation };
+        i2cSendMessage(CAMERA_Heading, &heading, sizeof(CAMERA_HEADING));
         
         #ifdef DEBUG_ROTATION
             loggingSerial.println(cameraSensorData.rotation / 10.0, 1);
         #endif
     }
+
+    // the detection finds one object so far, the message has room for more
+    void i2cSendObstacles() {
+        CAMERA_OBSTACLES obstacles = {};
+        if(cameraSensorData.object.available) {
+            obstacles.count = 1;
+            obstacles.objects[0] = 1 | (cameraSensorData.object.color << 1) | (cameraSensorData.object.direction << 2) | (cameraSensorData.object.angle << 3);
+        }
+        i2cSendMessage(CAMERA_Obstacles, &obstacles, sizeof(CAMERA_OBSTACLES));
+    }
+
+    void i2cSendHealth() {
+        CAMERA_HEALTH health = { halMillis(), frameTime, sendFailures, cameraErrors };
+        i2cSendMessage(CAMERA_Health, &health, sizeof(CAMERA_HEALTH));
+    }
 #endif
 
 #pragma endregion functions
@@ -0,0 +1,70 @@
+#include "control_task.h"
+
+void controlTaskFunction(void* parameter) {
+    ((CONTROL_TASK*)parameter)->run();
+}
+
+bool CONTROL_TASK::init(void (*function)(), uint16_t frequency, uint8_t priority, uint8_t core) {
+    _function = function;
+    _periodTicks = (configTICK_RATE_HZ / frequency) > 0 ? (configTICK_RATE_HZ / frequency) : 1;
+    resetStats();
+    return xTaskCreatePinnedToCore(controlTaskFunction, "Control Task", 10000, this, priority, &_task, core) == pdPASS;
+}
+
+CONTROL_TASK_STATS CONTROL_TASK::getStats() {
+    portENTER_CRITICAL(&_statsMux);
+    CONTROL_TASK_STATS stats = _stats;
+    portEXIT_CRITICAL(&_statsMux);
+    return stats;
+}
+
+void CONTROL_TASK::resetStats() {
+    portENTER_CRITICAL(&_statsMux);
+    _stats = {};
+    _stats.period = (_periodTicks * 1000000) / configTICK_RATE_HZ;
+    _stats.histogramBucketWidth = (2 * _stats.period) / CONTROL_TASK_HISTOGRAM_SIZE;
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+void CONTROL_TASK::run() {
+    uint32_t period = (_periodTicks * 1000000) / configTICK_RATE_HZ;
+    TickType_t lastWakeTime = xTaskGetTickCount();
+    int64_t scheduledStart = esp_timer_get_time();
+    while(true) {
+        int64_t start = esp_timer_get_time();
+        _function();
+        int64_t end = esp_timer_get_time();
+
+        uint32_t executionTime = (uint32_t)(end - start);
+        uint32_t jitter = (start > scheduledStart) ? (uint32_t)(start - scheduledStart) : 0;
+        uint8_t bucket = executionTime / _stats.histogramBucketWidth;
+
+        portENTER_CRITICAL(&_statsMux);
+        _stats.iterations++;
+        _stats.lastExecutionTime = executionTime;
+        if(executionTime > _stats.maxExecutionTime) {
+            _stats.maxExecutionTime = executionTime;
+        }
+        if(jitter > _stats.maxJitter) {
+            _stats.maxJitter = jitter;
+        }
+        if(end > scheduledStart + period) {
+            _stats.deadlineMisses++;
+        }
+        _stats.histogram[(bucket < CONTROL_TASK_HISTOGRAM_SIZE) ? bucket : (CONTROL_TASK_HISTOGRAM_SIZE - 1)]++;
+        portEXIT_CRITICAL(&_statsMux);
+
+        // after an overrun restart the schedule instead of running the missed periods back to back
+        TickType_t now = xTaskGetTickCount();
+        if(now - lastWakeTime > _periodTicks) {
+            uint32_t skipped = (now - lastWakeTime) / _periodTicks;
+            portENTER_CRITICAL(&_statsMux);
+            _stats.skippedPeriods += skipped;
+            portEXIT_CRITICAL(&_statsMux);
+            lastWakeTime += skipped * _periodTicks;
+            scheduledStart += (int64_t)skipped * period;
+        }
+        vTaskDelayUntil(&lastWakeTime, _periodTicks);
+        scheduledStart += period;
+    }
+}
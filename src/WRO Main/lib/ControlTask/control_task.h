@@ -0,0 +1,44 @@
+#ifndef CONTROL_TASK_H
+#define CONTROL_TASK_H
+
+/**
+ * Fixed rate control task library for ESP32 MCUs
+ * by TerraForce
+*/
+
+#define CONTROL_TASK_LIB_VERSION "1.0.0"
+
+#include <Arduino.h>
+
+#define CONTROL_TASK_HISTOGRAM_SIZE 16
+
+struct CONTROL_TASK_STATS {
+    uint32_t period;                // period in µs
+    uint32_t iterations;
+    uint32_t deadlineMisses;        // iterations that ended after their deadline
+    uint32_t skippedPeriods;        // periods dropped to get back on schedule
+    uint32_t lastExecutionTime;     // µs
+    uint32_t maxExecutionTime;      // µs
+    uint32_t maxJitter;             // largest start delay against the schedule in µs
+    uint32_t histogramBucketWidth;  // µs, the last bucket collects everything above
+    uint32_t histogram[CONTROL_TASK_HISTOGRAM_SIZE];
+};
+
+class CONTROL_TASK {
+    public:
+        bool init(void (*function)(), uint16_t frequency, uint8_t priority, uint8_t core);
+        CONTROL_TASK_STATS getStats();
+        void resetStats();
+
+    private:
+        friend void controlTaskFunction(void* parameter);
+        void run();
+
+        void (*_function)() = NULL;
+        TaskHandle_t _task = NULL;
+        TickType_t _periodTicks = 1;
+        CONTROL_TASK_STATS _stats = {};
+        portMUX_TYPE _statsMux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "course_map.h"
+
+void COURSE_MAP::init(uint8_t outerSide) {
+    _outerSide = outerSide;
+    mismatches = 0;
+    for(uint8_t i = 0; i < COURSE_SECTIONS; i++) {
+        sections[i] = {};
+        plans[i] = {};
+    }
+}
+
+void COURSE_MAP::setOuterSide(uint8_t outerSide) {
+    _outerSide = outerSide;
+}
+
+uint8_t COURSE_MAP::outerSide() {
+    return _outerSide;
+}
+
+void COURSE_MAP::addWallDistance(uint8_t section, uint16_t distance) {
+    COURSE_SECTION& s = sections[section % COURSE_SECTIONS];
+    if(s.complete || (s.wallSamples == 0xFFFF)) return;
+    s.wallDistance = (uint16_t)((((uint32_t)s.wallDistance * s.wallSamples) + distance) / (s.wallSamples + 1));
+    s.wallSamples++;
+}
+
+void COURSE_MAP::observePillar(uint8_t section, uint8_t color, uint16_t position) {
+    COURSE_SECTION& s = sections[section % COURSE_SECTIONS];
+    for(uint8_t i = 0; i < s.pillarCount; i++) {
+        uint16_t gap = (position > s.pillars[i].position) ? (position - s.pillars[i].position) : (s.pillars[i].position - position);
+        if(gap < COURSE_PILLAR_MATCH) {
+            if(s.pillars[i].color == color) return;
+            break;
+        }
+    }
+    if(s.complete) {
+        // the map is wrong here, the reactive logic drives this section from now on
+        if(!s.mismatch) mismatches++;
+        s.mismatch = true;
+        return;
+    }
+    if(s.pillarCount < COURSE_MAX_PILLARS) {
+        s.pillars[s.pillarCount++] = { color, position };
+    }
+}
+
+void COURSE_MAP::checkColor(uint8_t section, uint8_t color) {
+    COURSE_SECTION& s = sections[section % COURSE_SECTIONS];
+    if(!s.complete || s.mismatch) return;
+    for(uint8_t i = 0; i < s.pillarCount; i++) {
+        if(s.pillars[i].color == color) return;
+    }
+    mismatches++;
+    s.mismatch = true;
+}
+
+void COURSE_MAP::endSection(uint8_t section, uint16_t length) {
+    COURSE_SECTION& s = sections[section % COURSE_SECTIONS];
+    if(s.complete) return;
+    s.length = length;
+    s.complete = true;
+    plan(section % COURSE_SECTIONS);
+}
+
+bool COURSE_MAP::planned(uint8_t section) {
+    COURSE_SECTION& s = sections[section % COURSE_SECTIONS];
+    return s.complete && !s.mismatch && (plans[section % COURSE_SECTIONS].count > 0);
+}
+
+const COURSE_SEGMENT* COURSE_MAP::segment(uint8_t section, uint16_t position) {
+    COURSE_PLAN& p = plans[section % COURSE_SECTIONS];
+    if(p.count == 0) return 0;
+    uint8_t i = 0;
+    while((i + 1 < p.count) && (p.segments[i + 1].start <= position)) {
+        i++;
+    }
+    return &p.segments[i];
+}
+
+void COURSE_MAP::plan(uint8_t section) {
+    COURSE_SECTION& s = sections[section];
+    COURSE_PLAN& p = plans[section];
+    p.count = 0;
+
+    // pillars in driving order
+    COURSE_PILLAR pillars[COURSE_MAX_PILLARS];
+    for(uint8_t i = 0; i < s.pillarCount; i++) {
+        uint8_t j = i;
+        while((j > 0) && (pillars[j - 1].position > s.pillars[i].position)) {
+            pillars[j] = pillars[j - 1];
+            j--;
+        }
+        pillars[j] = s.pillars[i];
+    }
+
+    if(s.pillarCount == 0) {
+        uint16_t offset = (s.wallSamples > 0) ? s.wallDistance : ((COURSE_OUTER_LANE + COURSE_INNER_LANE) / 2);
+        p.segments[p.count++] = { 0, offset, COURSE_SPEED_FREE };
+    }
+    else {
+        p.segments[p.count++] = { 0, lane(pillars[0].color), COURSE_SPEED_LANE };
+        for(uint8_t i = 1; i < s.pillarCount; i++) {
+            if(pillars[i].color == pillars[i - 1].color) continue;
+            // change lanes halfway between two pillars of different colour
+            uint16_t start = (pillars[i - 1].position + pillars[i].position) / 2;
+            p.segments[p.count++] = { start, lane(pillars[i].color), COURSE_SPEED_LANE_CHANGE };
+            p.segments[p.count++] = { pillars[i].position, lane(pillars[i].color), COURSE_SPEED_LANE };
+        }
+    }
+
+    if(s.length > COURSE_APPROACH_DISTANCE) {
+        uint16_t start = s.length - COURSE_APPROACH_DISTANCE;
+        uint16_t offset = p.segments[p.count - 1].offset;
+        if(start > p.segments[p.count - 1].start) {
+            p.segments[p.count++] = { start, offset, COURSE_SPEED_APPROACH };
+        }
+    }
+}
+
+uint16_t COURSE_MAP::lane(uint8_t color) {
+    // green is passed on the left, red on the right
+    bool passLeft = color == 0;
+    bool outerLeft = _outerSide == 1;
+    return (passLeft == outerLeft) ? COURSE_OUTER_LANE : COURSE_INNER_LANE;
+}
@@ -0,0 +1,83 @@
+#ifndef COURSE_MAP_H
+#define COURSE_MAP_H
+
+/**
+ * Course map and lap planning library
+ * by TerraForce
+*/
+
+#define COURSE_MAP_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+
+#define COURSE_SECTIONS             4
+#define COURSE_MAX_PILLARS          4
+#define COURSE_MAX_SEGMENTS         (2 * COURSE_MAX_PILLARS)   // a lane change adds two segments, the approach one
+#define COURSE_PILLAR_MATCH         300     // observations within this distance of a mapped pillar confirm it in mm
+
+// lanes as distance to the outer wall in mm
+#define COURSE_OUTER_LANE           200
+#define COURSE_INNER_LANE           600
+#define COURSE_APPROACH_DISTANCE    600     // end of the section driven at approach speed in mm
+
+// speed offsets below the maximum speed
+#define COURSE_SPEED_FREE           0
+#define COURSE_SPEED_LANE           2
+#define COURSE_SPEED_LANE_CHANGE    3
+#define COURSE_SPEED_APPROACH       3
+
+struct COURSE_PILLAR {
+    uint8_t color;      // 0: green (passed left), 1: red (passed right)
+    uint16_t position;  // distance from the section start at which the pillar was passed in mm
+};
+
+struct COURSE_SECTION {
+    COURSE_PILLAR pillars[COURSE_MAX_PILLARS];
+    uint8_t pillarCount;
+    uint16_t length;        // distance from curve end to the next curve in mm
+    uint16_t wallDistance;  // mean distance to the outer wall in mm
+    uint16_t wallSamples;
+    bool complete;          // driven once from curve to curve
+    bool mismatch;          // later laps saw something the map does not contain
+};
+
+struct COURSE_SEGMENT {
+    uint16_t start;     // distance from the section start in mm
+    uint16_t offset;    // target distance to the outer wall in mm
+    uint8_t speed;      // offset below the maximum speed
+};
+
+struct COURSE_PLAN {
+    COURSE_SEGMENT segments[COURSE_MAX_SEGMENTS];
+    uint8_t count;
+};
+
+class COURSE_MAP {
+    public:
+        void init(uint8_t outerSide);
+        void setOuterSide(uint8_t outerSide);
+
+        // recording (first traversal) and verification (later traversals)
+        void addWallDistance(uint8_t section, uint16_t distance);
+        void observePillar(uint8_t section, uint8_t color, uint16_t position);
+        void checkColor(uint8_t section, uint8_t color);
+        void endSection(uint8_t section, uint16_t length);
+
+        bool planned(uint8_t section);
+        const COURSE_SEGMENT* segment(uint8_t section, uint16_t position);
+
+        // lane to pass a pillar of the color on and the outer side it is measured from
+        uint16_t lane(uint8_t color);
+        uint8_t outerSide();
+
+        COURSE_SECTION sections[COURSE_SECTIONS] = {};
+        COURSE_PLAN plans[COURSE_SECTIONS] = {};
+        uint32_t mismatches = 0;
+
+    private:
+        void plan(uint8_t section);
+
+        uint8_t _outerSide = 0; // 1: left, 2: right as in DRIVE_CONTROL directions
+};
+
+#endif
@@ -0,0 +1,208 @@
+#include "drive_control.h"
+#include <math.h>
+
+static void sequencerEndCurve(void* context) {
+    ((DRIVE_CONTROL*)context)->commands.speed = 8;
+}
+
+void DRIVE_CONTROL::init(uint8_t course, uint8_t maxSpeed, const SENSOR_SNAPSHOT& sensors) {
+    this->course = course;
+    this->maxSpeed = maxSpeed;
+    this->sensors = sensors;
+    _table = (course == ObstacleCourse) ? &obstacleCourseTable : &starterCourseTable;
+
+    commands = { 7, 0, 0, 0, 0 };
+    driveState = {};
+    outsideBorder = Unknown;
+    outsideBorder2 = Unknown;
+    curveCount = 0;
+    rotation = 0;
+    antiRotation = sensors.rotation;
+    targetRotation = 0;
+    lastCurve = -8000;
+    startPosDistance = sensors.distance[US_CenterFront];
+    startLeftDistance = sensors.distance[US_LeftFront];
+    startRightDistance = sensors.distance[US_RightFront];
+    lastCurveDistance = 0;
+
+    sequencer.clear();
+    sequencer.context = this;
+
+    steering.init();
+    steering.setWall(sensors.rotation);
+
+    odometry.init(DRIVE_MM_PER_MOTOR_TICK);
+    odometry.reset(sensors.motorTurns, sensors.rotation);
+
+    courseMap.init(Unknown);
+    _lastObject = {};
+
+    speedControl.init(DRIVE_MM_PER_MOTOR_TICK, DRIVE_FEED_FORWARD);
+    updateMotor(sensors);
+}
+
+void DRIVE_CONTROL::update(const SENSOR_SNAPSHOT& sensors) {
+    this->sensors = sensors;
+    rotation = sensors.rotation - antiRotation;
+    sequencer.update(sensors.time, sensors.motorTurns, sensors.rotation);
+    odometry.update(sensors.motorTurns, sensors.rotation);
+    if(odometry.hasField() && (driveState.state != Curve)) {
+        fixPose(sensors);
+    }
+    if((outerSide() != Unknown) && (driveState.state != Curve)) {
+        recordCourse(sensors);
+    }
+
+    // every row is checked at most once, so a tick costs at most one pass over the table
+    uint32_t matchedGroups = 0;
+    for(uint8_t i = 0; i < _table->count; i++) {
+        const DRIVE_TRANSITION& transition = _table->transitions[i];
+        if(!(transition.states & DRIVE_STATE_BIT(driveState.state))) continue;
+        if((transition.group > 0) && (matchedGroups & (1UL << transition.group))) continue;
+        if((transition.guard != NULL) && !transition.guard(*this, sensors)) continue;
+
+        if(transition.group > 0) {
+            matchedGroups |= 1UL << transition.group;
+        }
+        if(transition.direction != DRIVE_KEEP) {
+            driveState.direction = transition.direction;
+        }
+        if(transition.state != DRIVE_KEEP) {
+            driveState.state = transition.state;
+        }
+        if(transition.steering != DRIVE_KEEP_SERVO) {
+            steer(transition.steering);
+        }
+        if(transition.speed != DRIVE_KEEP_SERVO) {
+            commands.speed = (transition.speed < 0) ? (maxSpeed + transition.speed) : transition.speed;
+        }
+        if(transition.action != NULL) {
+            transition.action(*this, sensors);
+        }
+    }
+
+    updateMotor(sensors);
+}
+
+void DRIVE_CONTROL::startCurve(uint8_t direction) {
+    driveState.direction = direction;
+    driveState.state = Curve;
+    antiRotation = sensors.rotation;
+    targetRotation = (direction == Left) ? -1000 : 1000;
+    rotation = 0;
+    steer((direction == Left) ? -15 : 15);
+    commands.speed = maxSpeed - 1;
+
+    // the start section is only driven partly before the first curve, it is mapped in the second lap
+    if(curveCount == 0) {
+        courseMap.sections[0] = {};
+    }
+    else {
+        courseMap.endSection(section(), sectionPosition());
+    }
+    curveCount++;
+    // checked where the curve starts, sequenced curves start after the table has run
+    if(curveCount == 12) {
+        outsideBorder = End;
+    }
+    lastCurve = sensors.time;
+    lastCurveDistance = odometry.travelled;
+
+    // the next wall is a quarter turn further
+    steering.turn((direction == Left) ? -900 : 900);
+    steering.reset();
+}
+
+void DRIVE_CONTROL::endCurve() {
+    steer(0);
+    sequencer.add({ NULL, 50 });
+    sequencer.add({ sequencerEndCurve });
+    driveState.state = CurveEnding;
+    lastCurve = sensors.time;
+    lastCurveDistance = odometry.travelled;
+}
+
+// steering in command steps, the servo angle keeps the fraction
+void DRIVE_CONTROL::steer(float steering) {
+    commands.steering = (int8_t)lroundf(steering);
+    commands.steeringAngle = (int16_t)lroundf(steering * DRIVE_STEERING_STEP);
+}
+
+uint8_t DRIVE_CONTROL::outerSide() {
+    if(outsideBorder2 != Unknown) return outsideBorder2;
+    return ((outsideBorder == Left) || (outsideBorder == Right)) ? outsideBorder : Unknown;
+}
+
+// the start distances locate the outer walls and the pillar lanes once the driving direction is known
+void DRIVE_CONTROL::mapField(uint8_t side) {
+    uint16_t outer = (side == Left) ? startLeftDistance : startRightDistance;
+    courseMap.setOuterSide(side);
+    if((startPosDistance == 0) || (outer == 0)) return;
+    odometry.setField(startPosDistance + DRIVE_FRONT_SENSOR_OFFSET, outer + DRIVE_SIDE_SENSOR_OFFSET, (side == Left) ? -1 : 1);
+}
+
+bool DRIVE_CONTROL::encoderActive() {
+    return odometry.travelled > 0;
+}
+
+// a sample is fused once, the filtered distance is repeated every tick until the sensor fires again
+void DRIVE_CONTROL::fixPose(const SENSOR_SNAPSHOT& sensors) {
+    uint8_t side = outerSide();
+    if(side != Unknown) {
+        uint8_t front = (side == Left) ? US_LeftFront : US_RightFront;
+        uint8_t back = (side == Left) ? US_LeftBack : US_RightBack;
+        float angle = (side == Left) ? -M_PI / 2 : M_PI / 2;
+        if((sensors.updated & (1 << front)) && (sensors.distance[front] != 0) && (sensors.distance[front] < STEERING_MAX_WALL_DISTANCE)) {
+            odometry.fix(sensors.distance[front], angle, DRIVE_SIDE_SENSOR_OFFSET, powf(10 + (0.02 * sensors.distance[front]), 2));
+        }
+        if((sensors.updated & (1 << back)) && (sensors.distance[back] != 0) && (sensors.distance[back] < STEERING_MAX_WALL_DISTANCE)) {
+            odometry.fix(sensors.distance[back], angle, DRIVE_SIDE_SENSOR_OFFSET, powf(10 + (0.02 * sensors.distance[back]), 2));
+        }
+    }
+    uint16_t front = sensors.distance[US_CenterFront];
+    if((sensors.updated & (1 << US_CenterFront)) && (front != 0) && (front < DRIVE_MAX_FIX_DISTANCE)) {
+        odometry.fix(front, 0, DRIVE_FRONT_SENSOR_OFFSET, powf(10 + (0.02 * front), 2));
+    }
+}
+
+uint8_t DRIVE_CONTROL::section() {
+    return curveCount % COURSE_SECTIONS;
+}
+
+uint16_t DRIVE_CONTROL::sectionPosition() {
+    float position = odometry.travelled - lastCurveDistance;
+    return (uint16_t)((position < 0) ? 0 : ((position > 0xFFFF) ? 0xFFFF : position));
+}
+
+// laps after the first drive mapped sections on the plan, camera and ultrasonic only verify it
+bool DRIVE_CONTROL::followingPlan() {
+    return encoderActive() && (outerSide() != Unknown) && (driveState.state != Curve) && courseMap.planned(section());
+}
+
+const COURSE_SEGMENT* DRIVE_CONTROL::planSegment() {
+    return courseMap.segment(section(), sectionPosition());
+}
+
+void DRIVE_CONTROL::recordCourse(const SENSOR_SNAPSHOT& sensors) {
+    uint16_t outer = sensors.distance[(outerSide() == Left) ? US_LeftFront : US_RightFront];
+    if((outer != 0) && (outer < STEERING_MAX_WALL_DISTANCE)) {
+        courseMap.addWallDistance(section(), outer);
+    }
+
+    // a pillar leaves the camera view when the car passes it
+    if(sensors.object.available) {
+        courseMap.checkColor(section(), sensors.object.color);
+    }
+    else if(_lastObject.available) {
+        courseMap.observePillar(section(), _lastObject.color, sectionPosition());
+    }
+    _lastObject = sensors.object;
+}
+
+// the speed command is a wheel speed, with speedLoop the controller holds it independent of battery and load,
+// without it the speed is still measured for the calibration
+void DRIVE_CONTROL::updateMotor(const SENSOR_SNAPSHOT& sensors) {
+    commands.velocity = commands.speed * DRIVE_SPEED_STEP;
+    int8_t motor = speedControl.update(sensors.time, sensors.motorTurns, sensors.motorRpm, sensors.battery / 1000.0, commands.velocity, speedLoop && encoderActive());
+    commands.motor = speedLoop ? motor : commands.speed;
+}
@@ -0,0 +1,188 @@
+#ifndef DRIVE_CONTROL_H
+#define DRIVE_CONTROL_H
+
+/**
+ * Table driven drive control library
+ * by TerraForce
+*/
+
+#define DRIVE_CONTROL_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sequencer.h"
+#include "steering.h"
+#include "odometry.h"
+#include "course_map.h"
+#include "speed_control.h"
+
+#define DRIVE_KEEP                  0xFF    // row leaves direction / state unchanged
+#define DRIVE_KEEP_SERVO            INT8_MIN // row leaves the servo command unchanged
+#define DRIVE_MAX_SPEED(offset)     (-(offset)) // speed command relative to maxSpeed
+#define DRIVE_STATE_BIT(state)      (1 << (state))
+#define DRIVE_ALL_STATES            0xFF
+
+// state masks of the transition tables
+#define DRIVE_NOT_CURVING           (DRIVE_ALL_STATES & ~(DRIVE_STATE_BIT(Curve) | DRIVE_STATE_BIT(CurveEnding)))
+#define DRIVE_NOT_CURVING_BORDER    (DRIVE_NOT_CURVING & ~DRIVE_STATE_BIT(BorderCorrection))
+#define DRIVE_CORRECTING            (DRIVE_STATE_BIT(Unknown) | DRIVE_STATE_BIT(UltrasonicCorrection) | DRIVE_STATE_BIT(BorderCorrection) | DRIVE_STATE_BIT(CurveEnding))
+#define DRIVE_CORRECTING_HEADING    (DRIVE_CORRECTING & ~DRIVE_STATE_BIT(BorderCorrection))
+#define DRIVE_CORRECTION_ACTIVE     (DRIVE_STATE_BIT(UltrasonicCorrection) | DRIVE_STATE_BIT(BorderCorrection))
+#define DRIVE_NOT_IN_CURVE          (DRIVE_ALL_STATES & ~DRIVE_STATE_BIT(Curve))
+
+// odometry calibration
+#define DRIVE_MM_PER_MOTOR_TICK     2.5     // travel per 1/8 motor turn in mm
+#define DRIVE_SIDE_SENSOR_OFFSET    80      // side ultrasonic sensors to the car center in mm
+#define DRIVE_FRONT_SENSOR_OFFSET   150     // front ultrasonic sensor to the car center in mm
+#define DRIVE_MAX_FIX_DISTANCE      2500    // ultrasonic distances above are not used for wall fixes in mm
+#define DRIVE_MIN_SECTION_DISTANCE  800     // travel after a curve before the next one may start in mm
+#define DRIVE_MAX_STOP_DEVIATION    100     // pose standard deviation up to which the pose finds the start position in mm
+#define DRIVE_MAX_OBJECT_AGE        500     // older object data of WRO Camera is treated as no object in ms
+
+// speed control calibration, not measured yet: one speed step per motor step at SPEED_NOMINAL_VOLTAGE,
+// the speed loop stays open until both are measured on the car
+#define DRIVE_SPEED_STEP            100     // wheel speed per speed command step in mm/s
+#define DRIVE_FEED_FORWARD          (DRIVE_SPEED_STEP / SPEED_NOMINAL_VOLTAGE) // wheel speed per motor command step and battery volt in mm/s
+
+// servo calibration
+#define DRIVE_STEERING_STEP         60      // servo angle per steering and motor command step in 1/10 degrees
+
+enum UltraSonicPositions {
+    US_LeftFront,
+    US_CenterFront,
+    US_RightFront,
+    US_LeftBack,
+    US_CenterBack,
+    US_RightBack,
+    Variable
+};
+
+enum Directions {
+    Straight,
+    Left,
+    Right,
+    End
+};
+
+enum DriveStates {
+    Unknown,
+    Curve,
+    CurveEnding,
+    GyroCorrection,
+    UltrasonicCorrection,
+    BorderCorrection
+};
+
+enum Courses {
+    StarterCourse,
+    ObstacleCourse
+};
+
+struct DRIVE_STATE {
+    uint8_t direction   : 2;
+    uint8_t state       : 6;
+};
+
+// everything the drive control reads in one tick
+struct SENSOR_SNAPSHOT {
+    uint32_t time;          // ms
+    uint16_t distance[6];   // filtered ultrasonic distance in mm, 0 if no valid measurement
+    uint8_t updated;        // bit mask of the ultrasonic sensors with a new sample since the previous snapshot
+    int32_t rotation;       // gyro rotation in 1/10 degrees
+    struct OBJECT_DATA {
+        uint8_t available   : 1;
+        uint8_t color       : 1;
+        uint8_t direction   : 1;
+        uint8_t angle       : 5;
+    } object;
+    uint16_t rotationAge;   // since the rotation was received in ms, 0xFFFF if older
+    uint16_t objectAge;     // since the object was received in ms, 0xFFFF if older
+    int32_t motorTurns;     // 1/8 motor turns
+    int16_t motorRpm;       // of the last encoder period, 0 when standing or unknown
+    uint16_t battery;       // battery voltage in mV, 0 if unknown
+};
+
+struct DRIVE_COMMANDS {
+    int8_t speed;       // wheel speed in DRIVE_SPEED_STEP
+    int8_t steering;
+    int16_t velocity;   // target wheel speed in mm/s
+    int8_t motor;       // motor command of the speed controller
+    int16_t steeringAngle;  // steering servo angle in 1/10 degrees, finer than steering while the controller steers
+};
+
+class DRIVE_CONTROL;
+
+typedef bool (*DRIVE_GUARD)(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors);
+typedef void (*DRIVE_ACTION)(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors);
+
+struct DRIVE_TRANSITION {
+    uint8_t states;         // bit mask of the drive states the row applies to
+    uint8_t group;          // rows of the same group > 0 form an if / else if chain
+    DRIVE_GUARD guard;
+    uint8_t direction;      // next direction or DRIVE_KEEP
+    uint8_t state;          // next state or DRIVE_KEEP
+    int8_t steering;        // steering command or DRIVE_KEEP_SERVO
+    int8_t speed;           // speed command, DRIVE_MAX_SPEED(offset) or DRIVE_KEEP_SERVO
+    DRIVE_ACTION action;    // called after the fields above are applied, may be NULL
+};
+
+struct DRIVE_TABLE {
+    const DRIVE_TRANSITION* transitions;
+    uint8_t count;
+};
+
+extern const DRIVE_TABLE starterCourseTable;
+extern const DRIVE_TABLE obstacleCourseTable;
+
+class DRIVE_CONTROL {
+    public:
+        void init(uint8_t course, uint8_t maxSpeed, const SENSOR_SNAPSHOT& sensors);
+        void update(const SENSOR_SNAPSHOT& sensors);
+
+        // shared actions
+        void startCurve(uint8_t direction);
+        void endCurve();
+        void steer(float steering);
+        uint8_t outerSide();
+        void mapField(uint8_t side);
+        bool encoderActive();
+
+        // course map, sections are counted from the start section
+        uint8_t section();
+        uint16_t sectionPosition();
+        bool followingPlan();
+        const COURSE_SEGMENT* planSegment();
+
+        DRIVE_COMMANDS commands = {};
+        DRIVE_STATE driveState = {};
+        uint8_t course = StarterCourse;
+        uint8_t outsideBorder = Unknown;
+        uint8_t outsideBorder2 = Unknown;
+        uint8_t curveCount = 0;
+        uint8_t maxSpeed = 11;
+        int32_t rotation = 0;           // rotation since the last reference in 1/10 degrees
+        int32_t antiRotation = 0;       // reference of rotation
+        int32_t targetRotation = 0;     // rotation to curve target in 1/10 degrees
+        int64_t lastCurve = -8000;
+        uint16_t startPosDistance = 0;
+        uint16_t startLeftDistance = 0;
+        uint16_t startRightDistance = 0;
+        float lastCurveDistance = 0;    // odometry travel at the last curve in mm
+        SENSOR_SNAPSHOT sensors = {};   // snapshot of the current tick
+        SEQUENCER sequencer;
+        STEERING_CONTROLLER steering;
+        ODOMETRY odometry;
+        COURSE_MAP courseMap;
+        SPEED_CONTROLLER speedControl;
+        bool speedLoop = false;         // motor command of the speed controller instead of the speed command
+
+    private:
+        void fixPose(const SENSOR_SNAPSHOT& sensors);
+        void recordCourse(const SENSOR_SNAPSHOT& sensors);
+        void updateMotor(const SENSOR_SNAPSHOT& sensors);
+
+        const DRIVE_TABLE* _table = NULL;
+        SENSOR_SNAPSHOT::OBJECT_DATA _lastObject = {};
+};
+
+#endif
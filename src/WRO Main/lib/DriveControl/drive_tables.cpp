@@ -0,0 +1,322 @@
+#include "drive_control.h"
+
+#define NOT_CURVING         DRIVE_NOT_CURVING
+#define NOT_CURVING_BORDER  DRIVE_NOT_CURVING_BORDER
+#define CORRECTING          DRIVE_CORRECTING
+#define CORRECTING_HEADING  DRIVE_CORRECTING_HEADING
+#define CORRECTION_ACTIVE   DRIVE_CORRECTION_ACTIVE
+#define NOT_IN_CURVE        DRIVE_NOT_IN_CURVE
+#define KEEP                DRIVE_KEEP
+#define KEEP_SERVO          DRIVE_KEEP_SERVO
+
+
+#pragma region shared
+
+static bool outsideLeftDetected(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return (control.outsideBorder == Unknown) && (sensors.distance[US_RightFront] > 1100);
+}
+
+static bool outsideRightDetected(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return (control.outsideBorder == Unknown) && (sensors.distance[US_LeftFront] > 1100);
+}
+
+static bool startPositionReached(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    if((control.outsideBorder == Unknown) || (control.curveCount < 12) || control.sequencer.busy()) return false;
+    // the pose is only trusted while wall fixes keep it close
+    if(control.odometry.hasField() && (control.odometry.covariance[0][0] < DRIVE_MAX_STOP_DEVIATION * DRIVE_MAX_STOP_DEVIATION)) {
+        return control.odometry.x > -50;
+    }
+    return (sensors.distance[US_CenterFront] != 0) && (sensors.distance[US_CenterFront] < control.startPosDistance + 50);
+}
+
+// without encoder data the section is timed instead of measured, the first curve may come right away
+static bool sectionDriven(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors, uint32_t minTime) {
+    if(control.curveCount == 0) return true;
+    if(control.encoderActive()) {
+        return control.odometry.travelled > control.lastCurveDistance + DRIVE_MIN_SECTION_DISTANCE;
+    }
+    return sensors.time > control.lastCurve + minTime;
+}
+
+static bool curveFinished(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    const uint16_t* d = sensors.distance;
+    if((control.driveState.direction == Left) && (control.rotation <= control.targetRotation)) return true;
+    if((control.driveState.direction == Right) && (control.rotation >= control.targetRotation)) return true;
+    // right curves may end early once the car is parallel to the outer wall again
+    return (control.driveState.direction == Right) && (control.rotation > 800) && (((control.outsideBorder2 == Right) && (d[US_RightBack] - d[US_RightFront] < 10)) || ((control.outsideBorder2 == Left) && (d[US_LeftBack] - d[US_LeftFront] < 10)));
+}
+
+static bool curveEndingFinished(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return ((control.driveState.direction == Left) && (sensors.distance[US_LeftBack] < 1200)) || ((control.driveState.direction == Right) && (sensors.distance[US_RightBack] < 1200));
+}
+
+static void setOutsideLeft(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    control.outsideBorder = Left;
+    control.outsideBorder2 = Left;
+    control.mapField(Left);
+}
+
+static void setOutsideRight(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    control.outsideBorder = Right;
+    control.outsideBorder2 = Right;
+    control.mapField(Right);
+}
+
+static bool borderCleared(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return (sensors.distance[US_LeftFront] > 150) && (sensors.distance[US_RightFront] > 150);
+}
+
+static bool planActive(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return control.followingPlan() && (control.planSegment() != NULL);
+}
+
+static bool planSpeedActive(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return !control.sequencer.busy() && (control.outsideBorder != End) && planActive(control, sensors);
+}
+
+static void steerOnPlan(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    bool outerRight = control.outerSide() == Right;
+    uint16_t targetOffset = control.steering.targetOffset;
+    control.steering.targetOffset = control.planSegment()->offset;
+    control.steer(control.steering.update(sensors.time, sensors.rotation, sensors.distance[outerRight ? US_RightFront : US_LeftFront], sensors.distance[outerRight ? US_RightBack : US_LeftBack], outerRight ? 1 : -1));
+    control.steering.targetOffset = targetOffset;
+}
+
+static void applyPlanSpeed(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    control.commands.speed = control.maxSpeed - control.planSegment()->speed;
+}
+
+static void endCurve(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    control.endCurve();
+}
+
+static void startCurveLeft(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    control.startCurve(Left);
+}
+
+static void startCurveRight(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    control.startCurve(Right);
+}
+
+#pragma endregion shared
+
+
+#pragma region starter_course
+
+static bool starterAlignedToWall(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    const uint16_t* d = sensors.distance;
+    if((control.outsideBorder == Unknown) || (d[US_LeftBack] + d[US_RightBack] >= 1000) || (d[US_LeftFront] + d[US_RightFront] >= 1000)) return false;
+    return ((control.outsideBorder == Right) && (d[US_RightBack] == d[US_RightFront])) || ((control.outsideBorder == Left) && (d[US_LeftBack] == d[US_LeftFront]));
+}
+
+static bool starterCurveLeft(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return (control.curveCount < 12) && sectionDriven(control, sensors, 4000) && (control.outsideBorder == Right) && (sensors.distance[US_LeftFront] > 1100);
+}
+
+static bool starterCurveRight(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return (control.curveCount < 12) && sectionDriven(control, sensors, 4000) && (control.outsideBorder == Left) && (sensors.distance[US_RightFront] > 1100);
+}
+
+static bool starterSteeringActive(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return control.outerSide() != Unknown;
+}
+
+static bool starterLeftBorderVeryNear(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return (sensors.distance[US_LeftFront] < 80) && (sensors.distance[US_LeftFront] != 0);
+}
+
+static bool starterLeftBorderNear(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return (sensors.distance[US_LeftFront] < 120) && (sensors.distance[US_LeftFront] != 0);
+}
+
+static bool starterRightBorderVeryNear(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return (sensors.distance[US_RightFront] < 80) && (sensors.distance[US_RightFront] != 0);
+}
+
+static bool starterRightBorderNear(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return (sensors.distance[US_RightFront] < 120) && (sensors.distance[US_RightFront] != 0);
+}
+
+static bool starterApproachingWall(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return !control.sequencer.busy() && (control.outsideBorder != End) && (sensors.distance[US_CenterFront] < 1200);
+}
+
+static bool starterDriving(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return !control.sequencer.busy() && (control.outsideBorder != End);
+}
+
+static void resetAntiRotation(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    control.antiRotation = sensors.rotation;
+}
+
+static void steerAlongWall(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    bool outerRight = control.outerSide() == Right;
+    control.steer(control.steering.update(sensors.time, sensors.rotation, sensors.distance[outerRight ? US_RightFront : US_LeftFront], sensors.distance[outerRight ? US_RightBack : US_LeftBack], outerRight ? 1 : -1));
+}
+
+static const DRIVE_TRANSITION starterCourseTransitions[] = {
+    // states                                    group   guard                       direction   state                   steering    speed                 action
+    { NOT_CURVING,                              0,      starterAlignedToWall,       KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           resetAntiRotation },
+    { DRIVE_ALL_STATES,                         0,      outsideLeftDetected,        KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           setOutsideLeft },
+    { DRIVE_ALL_STATES,                         0,      outsideRightDetected,       KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           setOutsideRight },
+
+    // curves
+    { NOT_CURVING,                              0,      starterCurveLeft,           KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           startCurveLeft },
+    { NOT_CURVING,                              0,      starterCurveRight,          KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           startCurveRight },
+    { NOT_CURVING,                              0,      startPositionReached,       KEEP,       KEEP,                   KEEP_SERVO, 0,                    NULL },
+    { DRIVE_STATE_BIT(Curve),                   0,      curveFinished,              KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           endCurve },
+    { DRIVE_STATE_BIT(CurveEnding),             0,      curveEndingFinished,        Straight,   Unknown,                KEEP_SERVO, KEEP_SERVO,           NULL },
+
+    // direction and offset correction (gyro and ultrasonic), overridden near the border
+    { CORRECTING_HEADING,                       1,      planActive,                 KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           steerOnPlan },
+    { CORRECTING_HEADING,                       1,      starterSteeringActive,      KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           steerAlongWall },
+
+    // near border correction (ultrasonic)
+    { DRIVE_STATE_BIT(BorderCorrection),        0,      borderCleared,              Straight,   Unknown,                0,          KEEP_SERVO,           NULL },
+    { CORRECTING,                               2,      starterLeftBorderVeryNear,  Right,      BorderCorrection,       10,         KEEP_SERVO,           NULL },
+    { CORRECTING,                               2,      starterLeftBorderNear,      Right,      BorderCorrection,       7,          KEEP_SERVO,           NULL },
+    { CORRECTING,                               2,      starterRightBorderVeryNear, Left,       BorderCorrection,       -10,        KEEP_SERVO,           NULL },
+    { CORRECTING,                               2,      starterRightBorderNear,     Left,       BorderCorrection,       -7,         KEEP_SERVO,           NULL },
+
+    // speed
+    { CORRECTING,                               3,      planSpeedActive,            KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           applyPlanSpeed },
+    { CORRECTING,                               3,      starterApproachingWall,     KEEP,       KEEP,                   KEEP_SERVO, DRIVE_MAX_SPEED(2),   NULL },
+    { CORRECTION_ACTIVE,                        3,      starterDriving,             KEEP,       KEEP,                   KEEP_SERVO, DRIVE_MAX_SPEED(3),   NULL },
+    { CORRECTING,                               3,      starterDriving,             KEEP,       KEEP,                   KEEP_SERVO, DRIVE_MAX_SPEED(1),   NULL }
+};
+
+const DRIVE_TABLE starterCourseTable = { starterCourseTransitions, sizeof(starterCourseTransitions) / sizeof(DRIVE_TRANSITION) };
+
+#pragma endregion starter_course
+
+
+#pragma region obstacle_course
+
+static bool obstacleIdle(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return !control.sequencer.busy();
+}
+
+static bool obstacleApproachingWall(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return !control.sequencer.busy() && (sensors.distance[US_CenterFront] < 1000);
+}
+
+static bool obstacleCurveLeft(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return !control.sequencer.busy() && (control.curveCount < 12) && sectionDriven(control, sensors, 6000) && (control.outsideBorder == Right) && (sensors.distance[US_LeftFront] > 1300);
+}
+
+static bool obstacleCurveRight(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return !control.sequencer.busy() && (control.curveCount < 12) && sectionDriven(control, sensors, 8000) && (control.outsideBorder == Left) && (sensors.distance[US_RightFront] > 1300);
+}
+
+static bool obstacleSteeringActive(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return control.courseMap.outerSide() != Unknown;
+}
+
+static bool obstacleLeftBorderNear(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return (sensors.distance[US_LeftFront] < 100) && (sensors.distance[US_LeftFront] != 0);
+}
+
+static bool obstacleRightBorderNear(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    return (sensors.distance[US_RightFront] < 100) && (sensors.distance[US_RightFront] != 0);
+}
+
+// green objects are passed on the left side, red ones on the right, the lane of the last one is kept until the next one is seen
+static void steerOnPassLane(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    if(sensors.object.available) {
+        control.steering.targetOffset = control.courseMap.lane(sensors.object.color);
+    }
+    bool outerRight = control.courseMap.outerSide() == Right;
+    control.steer(control.steering.update(sensors.time, sensors.rotation, sensors.distance[outerRight ? US_RightFront : US_LeftFront], sensors.distance[outerRight ? US_RightBack : US_LeftBack], outerRight ? 1 : -1));
+}
+
+static void sequencerSpeedUp(void* context) {
+    DRIVE_CONTROL* control = (DRIVE_CONTROL*)context;
+    control->commands.speed = control->maxSpeed - 1;
+}
+
+static void sequencerStartCurveLeft(void* context) {
+    ((DRIVE_CONTROL*)context)->startCurve(Left);
+}
+
+static void sequencerStartCurveRight(void* context) {
+    ((DRIVE_CONTROL*)context)->startCurve(Right);
+}
+
+static void sequencerCheckRedObject(void* context) {
+    DRIVE_CONTROL* control = (DRIVE_CONTROL*)context;
+    if(control->sensors.object.available && (control->sensors.object.color == 1)) {
+        control->sequencer.add({ sequencerSpeedUp, 1000 });
+    }
+    control->sequencer.add({ sequencerStartCurveLeft });
+}
+
+static void sequencerCheckGreenObject(void* context) {
+    DRIVE_CONTROL* control = (DRIVE_CONTROL*)context;
+    if(control->sensors.object.available && (control->sensors.object.color == 0)) {
+        control->sequencer.add({ sequencerSpeedUp, 1000 });
+    }
+    control->sequencer.add({ sequencerStartCurveRight });
+}
+
+// pass a pillar in front of the curve before turning, corrections keep running meanwhile,
+// without one the curve starts 500 ms or 100 mm after the opening was seen, whichever comes first
+static void queueCurveLeft(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    if(sensors.object.available && (sensors.object.color == 1)) {
+        control.sequencer.add({ sequencerSpeedUp, 1500 });
+        control.sequencer.add({ sequencerStartCurveLeft });
+    }
+    else {
+        control.sequencer.add({ NULL, 500, 40 });
+        control.sequencer.add({ sequencerCheckRedObject });
+    }
+}
+
+static void queueCurveRight(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    if(sensors.object.available && (sensors.object.color == 0)) {
+        control.sequencer.add({ sequencerSpeedUp, 1500 });
+        control.sequencer.add({ sequencerStartCurveRight });
+    }
+    else {
+        control.sequencer.add({ NULL, 500, 40 });
+        control.sequencer.add({ sequencerCheckGreenObject });
+    }
+}
+
+static void setOutsideLeftOnly(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    control.outsideBorder = Left;
+    control.mapField(Left);
+}
+
+static void setOutsideRightOnly(DRIVE_CONTROL& control, const SENSOR_SNAPSHOT& sensors) {
+    control.outsideBorder = Right;
+    control.mapField(Right);
+}
+
+static const DRIVE_TRANSITION obstacleCourseTransitions[] = {
+    // states                                    group   guard                       direction   state                   steering    speed                 action
+    { NOT_IN_CURVE,                             1,      planSpeedActive,            KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           applyPlanSpeed },
+    { NOT_IN_CURVE,                             1,      obstacleApproachingWall,    KEEP,       KEEP,                   KEEP_SERVO, 6,                    NULL },
+    { NOT_IN_CURVE,                             1,      obstacleIdle,               KEEP,       KEEP,                   KEEP_SERVO, 8,                    NULL },
+    { DRIVE_ALL_STATES,                         0,      outsideLeftDetected,        KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           setOutsideLeftOnly },
+    { DRIVE_ALL_STATES,                         0,      outsideRightDetected,       KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           setOutsideRightOnly },
+
+    // curves
+    { NOT_CURVING_BORDER,                       0,      obstacleCurveLeft,          KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           queueCurveLeft },
+    { NOT_CURVING_BORDER,                       0,      obstacleCurveRight,         KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           queueCurveRight },
+    { NOT_CURVING_BORDER,                       0,      startPositionReached,       KEEP,       KEEP,                   KEEP_SERVO, 0,                    NULL },
+    { DRIVE_STATE_BIT(Curve),                   0,      curveFinished,              KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           endCurve },
+    { DRIVE_STATE_BIT(CurveEnding),             0,      curveEndingFinished,        Straight,   Unknown,                KEEP_SERVO, KEEP_SERVO,           NULL },
+
+    // heading and offset correction (gyro and ultrasonic) on the pass lane of the next object, mapped sections follow the plan instead
+    { CORRECTING,                               2,      planActive,                 Straight,   Unknown,                KEEP_SERVO, KEEP_SERVO,           steerOnPlan },
+    { CORRECTING_HEADING,                       2,      obstacleSteeringActive,     KEEP,       KEEP,                   KEEP_SERVO, KEEP_SERVO,           steerOnPassLane },
+
+    // near border correction (ultrasonic), overrides the pass lane
+    { DRIVE_STATE_BIT(BorderCorrection),        0,      borderCleared,              Straight,   Unknown,                0,          KEEP_SERVO,           NULL },
+    { CORRECTING,                               3,      obstacleLeftBorderNear,     Right,      BorderCorrection,       10,         KEEP_SERVO,           NULL },
+    { CORRECTING,                               3,      obstacleRightBorderNear,    Left,       BorderCorrection,       -10,        KEEP_SERVO,           NULL }
+};
+
+const DRIVE_TABLE obstacleCourseTable = { obstacleCourseTransitions, sizeof(obstacleCourseTransitions) / sizeof(DRIVE_TRANSITION) };
+
+#pragma endregion obstacle_course
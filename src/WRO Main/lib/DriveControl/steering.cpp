@@ -0,0 +1,45 @@
+#include "steering.h"
+#include <math.h>
+
+void STEERING_CONTROLLER::init() {
+    offsetPid.init({ 0.3, 0.02, 0 }, -150, 150);
+    headingPid.init({ 0.05, 0.01, 0.002 }, -15, 15, 100);
+    reset();
+}
+
+void STEERING_CONTROLLER::reset() {
+    offsetPid.reset();
+    headingPid.reset();
+    _running = false;
+}
+
+void STEERING_CONTROLLER::setWall(int32_t rotation) {
+    _wallRotation = rotation;
+}
+
+void STEERING_CONTROLLER::turn(int32_t change) {
+    _wallRotation += change;
+}
+
+float STEERING_CONTROLLER::update(uint32_t time, int32_t rotation, uint16_t outerFront, uint16_t outerBack, int8_t side) {
+    float dt = (time - _lastTime) / 1000.0;
+    _lastTime = time;
+    if(!_running || (dt * 1000 > STEERING_MAX_INTERVAL)) {
+        reset();
+        _running = true;
+        return 0;
+    }
+
+    heading = rotation - _wallRotation;
+    float headingTarget = 0;
+    if((outerFront != 0) && (outerBack != 0) && (outerFront < STEERING_MAX_WALL_DISTANCE) && (outerBack < STEERING_MAX_WALL_DISTANCE)) {
+        // the front and back sensors see the wall angle directly, use it to remove gyro drift
+        float wallHeading = atan2f(side * ((float)outerBack - outerFront), STEERING_SENSOR_SPACING) * (1800 / M_PI);
+        _wallRotation += (heading - wallHeading) * wallFusion;
+        heading = rotation - _wallRotation;
+
+        offset = ((outerFront + outerBack) / 2.0) * cosf(heading * (M_PI / 1800));
+        headingTarget = -side * offsetPid.update(targetOffset - offset, dt);
+    }
+    return headingPid.update(headingTarget - heading, dt);
+}
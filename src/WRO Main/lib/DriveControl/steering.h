@@ -0,0 +1,41 @@
+#ifndef STEERING_H
+#define STEERING_H
+
+/**
+ * Wall relative steering controller
+ * by TerraForce
+*/
+
+#include <stdint.h>
+#include "pid.h"
+
+#define STEERING_SENSOR_SPACING     160     // distance between front and back ultrasonic sensor in mm
+#define STEERING_MAX_WALL_DISTANCE  1000    // wall distances above are not used for the offset
+#define STEERING_MAX_INTERVAL       200     // updates further apart restart the controller in ms
+
+class STEERING_CONTROLLER {
+    public:
+        void init();
+        void reset();
+        void setWall(int32_t rotation);
+        void turn(int32_t change);
+
+        // side: 1 = outer wall on the right, -1 = outer wall on the left
+        // returns the steering command in steps, unrounded
+        float update(uint32_t time, int32_t rotation, uint16_t outerFront, uint16_t outerBack, int8_t side);
+
+        PID offsetPid;      // lateral offset error in mm -> heading setpoint in 1/10 degrees
+        PID headingPid;     // heading error in 1/10 degrees -> steering command
+        uint16_t targetOffset = 400;    // distance to the outer wall in mm
+        float wallFusion = 0.02;        // share of the ultrasonic heading that corrects the gyro reference per update
+
+        float heading = 0;              // heading relative to the wall in 1/10 degrees, positive to the right
+        float offset = 0;               // distance to the outer wall in mm
+
+    private:
+        float _wallRotation = 0;        // gyro rotation parallel to the current wall
+        uint32_t _lastTime = 0;
+        bool _running = false;
+};
+
+#endif
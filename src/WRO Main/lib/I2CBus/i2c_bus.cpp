@@ -0,0 +1,133 @@
+#include "i2c_bus.h"
+
+void i2cBusTaskFunction(void* parameter) {
+    ((I2C_BUS*)parameter)->run();
+}
+
+bool I2C_BUS::init(TwoWire* wire, uint8_t priority, uint8_t core) {
+    _wire = wire;
+    for(uint8_t i = 0; i < I2C_Priorities; i++) {
+        _queues[i] = xQueueCreate(I2C_BUS_QUEUE_SIZE[i], sizeof(I2C_TRANSACTION));
+        if(_queues[i] == NULL) return false;
+    }
+    resetStats();
+    return xTaskCreatePinnedToCore(i2cBusTaskFunction, "I2C Bus Task", 4096, this, priority, &_task, core) == pdPASS;
+}
+
+bool I2C_BUS::write(uint8_t address, const uint8_t* data, uint8_t length, uint8_t priority, volatile uint8_t* status) {
+    I2C_TRANSACTION transaction = {};
+    transaction.address = address;
+    transaction.priority = priority;
+    transaction.writeLength = (length > I2C_BUS_MAX_WRITE) ? I2C_BUS_MAX_WRITE : length;
+    if(transaction.writeLength > 0) {
+        memcpy(transaction.data, data, transaction.writeLength);
+    }
+    transaction.status = status;
+    return submit(transaction);
+}
+
+bool I2C_BUS::read(uint8_t address, uint8_t* buffer, uint8_t length, uint8_t priority, volatile uint8_t* status) {
+    I2C_TRANSACTION transaction = {};
+    transaction.address = address;
+    transaction.priority = priority;
+    transaction.readLength = length;
+    transaction.readBuffer = buffer;
+    transaction.status = status;
+    return submit(transaction);
+}
+
+bool I2C_BUS::readRegisters(uint8_t address, uint8_t reg, uint8_t* buffer, uint8_t length, uint8_t priority, volatile uint8_t* status) {
+    I2C_TRANSACTION transaction = {};
+    transaction.address = address;
+    transaction.priority = priority;
+    transaction.writeLength = 1;
+    transaction.data[0] = reg;
+    transaction.readLength = length;
+    transaction.readBuffer = buffer;
+    transaction.status = status;
+    return submit(transaction);
+}
+
+I2C_BUS_STATS I2C_BUS::getStats(uint8_t priority) {
+    portENTER_CRITICAL(&_statsMux);
+    I2C_BUS_STATS stats = _stats[(priority < I2C_Priorities) ? priority : (I2C_Priorities - 1)];
+    portEXIT_CRITICAL(&_statsMux);
+    return stats;
+}
+
+void I2C_BUS::resetStats() {
+    portENTER_CRITICAL(&_statsMux);
+    for(uint8_t i = 0; i < I2C_Priorities; i++) {
+        _stats[i] = {};
+    }
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+bool I2C_BUS::submit(I2C_TRANSACTION& transaction) {
+    if((_task == NULL) || (transaction.priority >= I2C_Priorities)) return false;
+    transaction.submitTime = (uint32_t)esp_timer_get_time();
+    if(transaction.status != NULL) {
+        *transaction.status = I2C_Pending;
+    }
+    if(xQueueSend(_queues[transaction.priority], &transaction, 0) != pdTRUE) {
+        if(transaction.status != NULL) {
+            *transaction.status = I2C_Failed;
+        }
+        portENTER_CRITICAL(&_statsMux);
+        _stats[transaction.priority].dropped++;
+        portEXIT_CRITICAL(&_statsMux);
+        return false;
+    }
+    xTaskNotifyGive(_task);
+    return true;
+}
+
+void I2C_BUS::run() {
+    I2C_TRANSACTION transaction;
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // always take the most urgent transaction, so an actuator waits at most for one display chunk
+        bool found = true;
+        while(found) {
+            found = false;
+            for(uint8_t i = 0; i < I2C_Priorities; i++) {
+                if(xQueueReceive(_queues[i], &transaction, 0) == pdTRUE) {
+                    execute(transaction);
+                    found = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void I2C_BUS::execute(I2C_TRANSACTION& transaction) {
+    bool success = true;
+    // an empty write only addresses the device, e.g. to scan the bus
+    if((transaction.writeLength > 0) || (transaction.readLength == 0)) {
+        _wire->beginTransmission(transaction.address);
+        _wire->write(transaction.data, transaction.writeLength);
+        success = _wire->endTransmission(transaction.readLength == 0) == 0;
+    }
+    if(success && (transaction.readLength > 0)) {
+        success = _wire->requestFrom(transaction.address, (size_t)transaction.readLength) == transaction.readLength;
+        if(success) {
+            _wire->readBytes(transaction.readBuffer, transaction.readLength);
+        }
+    }
+    if(transaction.status != NULL) {
+        *transaction.status = success ? I2C_Done : I2C_Failed;
+    }
+
+    uint32_t latency = (uint32_t)esp_timer_get_time() - transaction.submitTime;
+    portENTER_CRITICAL(&_statsMux);
+    I2C_BUS_STATS& stats = _stats[transaction.priority];
+    stats.transactions++;
+    stats.failures += !success;
+    stats.totalLatency += latency;
+    if(latency > stats.maxLatency) {
+        stats.maxLatency = latency;
+    }
+    portEXIT_CRITICAL(&_statsMux);
+}
@@ -0,0 +1,79 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+/**
+ * Prioritised asynchronous I2C bus library for ESP32 MCUs
+ * by TerraForce
+*/
+
+#define I2C_BUS_LIB_VERSION "1.0.0"
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define I2C_BUS_MAX_WRITE       33      // display chunks are a control byte and 32 data bytes
+#define I2C_BUS_QUEUE_SIZE      (uint8_t[]){ 8, 8, 24 }
+
+enum I2C_PRIORITIES {
+    I2C_Actuator,   // servo and light commands
+    I2C_Sensor,     // power board reads
+    I2C_Display,    // OLED transfers, sent in chunks
+    I2C_Priorities
+};
+
+enum I2C_STATUS {
+    I2C_Idle,
+    I2C_Pending,
+    I2C_Done,
+    I2C_Failed
+};
+
+struct I2C_TRANSACTION {
+    uint8_t address;
+    uint8_t priority;
+    uint8_t writeLength;
+    uint8_t readLength;
+    uint8_t data[I2C_BUS_MAX_WRITE];    // written before reading, copied on submit
+    uint8_t* readBuffer;                // owned by the caller until status leaves I2C_Pending
+    volatile uint8_t* status;           // optional completion flag of this transaction
+    uint32_t submitTime;                // µs
+};
+
+struct I2C_BUS_STATS {
+    uint32_t transactions;
+    uint32_t failures;
+    uint32_t dropped;       // submits rejected because the queue was full
+    uint32_t maxLatency;    // submit to completion in µs
+    uint64_t totalLatency;  // µs
+};
+
+class I2C_BUS {
+    public:
+        bool init(TwoWire* wire, uint8_t priority, uint8_t core);
+
+        // non blocking, false if the queue of the priority is full
+        // status is set to I2C_Pending on submit and to I2C_Done or I2C_Failed when the transaction ends,
+        // a status shared by several queued transactions only keeps the result of the last one finished
+        bool write(uint8_t address, const uint8_t* data, uint8_t length, uint8_t priority, volatile uint8_t* status = NULL);
+        bool read(uint8_t address, uint8_t* buffer, uint8_t length, uint8_t priority, volatile uint8_t* status = NULL);
+
+        // writes the register address and reads from there after a repeated start
+        bool readRegisters(uint8_t address, uint8_t reg, uint8_t* buffer, uint8_t length, uint8_t priority, volatile uint8_t* status = NULL);
+
+        I2C_BUS_STATS getStats(uint8_t priority);
+        void resetStats();
+
+    private:
+        friend void i2cBusTaskFunction(void* parameter);
+        bool submit(I2C_TRANSACTION& transaction);
+        void run();
+        void execute(I2C_TRANSACTION& transaction);
+
+        TwoWire* _wire = NULL;
+        TaskHandle_t _task = NULL;
+        QueueHandle_t _queues[I2C_Priorities] = {};
+        I2C_BUS_STATS _stats[I2C_Priorities] = {};
+        portMUX_TYPE _statsMux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include "odometry.h"
+#include <math.h>
+
+#define GYRO_TO_RAD (M_PI / 1800) // gyro rotation is in 1/10 degrees
+
+void ODOMETRY::init(float mmPerTick) {
+    _mmPerTick = mmPerTick;
+    _wallCount = 0;
+}
+
+void ODOMETRY::reset(int32_t motorTurns, int32_t rotation) {
+    x = 0;
+    y = 0;
+    theta = 0;
+    travelled = 0;
+    for(uint8_t i = 0; i < 3; i++) {
+        for(uint8_t j = 0; j < 3; j++) {
+            covariance[i][j] = 0;
+        }
+    }
+    // the car is placed by hand, so the start pose is known to a few cm and degrees
+    covariance[0][0] = 30 * 30;
+    covariance[1][1] = 30 * 30;
+    covariance[2][2] = 0.05 * 0.05;
+    _lastTurns = motorTurns;
+    _lastGyro = rotation * GYRO_TO_RAD;
+    _headingOffset = -_lastGyro;
+    acceptedFixes = 0;
+    rejectedFixes = 0;
+}
+
+void ODOMETRY::update(int32_t motorTurns, int32_t rotation) {
+    // a quadrature encoder counts down when reversing
+    float distance = (motorTurns - _lastTurns) * _mmPerTick;
+    float gyro = rotation * GYRO_TO_RAD;
+    float turned = gyro - _lastGyro;
+    _lastTurns = motorTurns;
+    _lastGyro = gyro;
+
+    float newTheta = gyro + _headingOffset;
+    float midTheta = (theta + newTheta) / 2;
+    float c = cosf(midTheta);
+    float s = sinf(midTheta);
+    x += distance * c;
+    y += distance * s;
+    theta = newTheta;
+    travelled += distance;
+
+    // P = F P F' + G Q G' with F = d(x, y, theta) / d(x, y, theta), G = d(x, y, theta) / d(distance, heading)
+    float f02 = -distance * s;
+    float f12 = distance * c;
+    float p[3][3];
+    for(uint8_t i = 0; i < 3; i++) {
+        for(uint8_t j = 0; j < 3; j++) {
+            p[i][j] = covariance[i][j];
+        }
+    }
+    float fp[3][3];
+    for(uint8_t j = 0; j < 3; j++) {
+        fp[0][j] = p[0][j] + f02 * p[2][j];
+        fp[1][j] = p[1][j] + f12 * p[2][j];
+        fp[2][j] = p[2][j];
+    }
+    for(uint8_t i = 0; i < 3; i++) {
+        covariance[i][0] = fp[i][0] + fp[i][2] * f02;
+        covariance[i][1] = fp[i][1] + fp[i][2] * f12;
+        covariance[i][2] = fp[i][2];
+    }
+    float distanceVariance = ODOMETRY_DISTANCE_NOISE * fabsf(distance);
+    float headingVariance = (ODOMETRY_HEADING_NOISE * fabsf(turned)) + ODOMETRY_HEADING_DRIFT;
+    covariance[0][0] += (c * c * distanceVariance) + (f02 * f02 * headingVariance);
+    covariance[0][1] += (c * s * distanceVariance) + (f02 * f12 * headingVariance);
+    covariance[1][0] += (c * s * distanceVariance) + (f02 * f12 * headingVariance);
+    covariance[1][1] += (s * s * distanceVariance) + (f12 * f12 * headingVariance);
+    covariance[0][2] += f02 * headingVariance;
+    covariance[2][0] += f02 * headingVariance;
+    covariance[1][2] += f12 * headingVariance;
+    covariance[2][1] += f12 * headingVariance;
+    covariance[2][2] += headingVariance;
+}
+
+void ODOMETRY::setField(float frontWall, float outerWall, int8_t side) {
+    _walls[0] = { 1, side * outerWall };
+    _walls[1] = { 1, side * (outerWall - ODOMETRY_FIELD_SIZE) };
+    _walls[2] = { 0, frontWall };
+    _walls[3] = { 0, frontWall - ODOMETRY_FIELD_SIZE };
+    _wallCount = 4;
+}
+
+bool ODOMETRY::hasField() {
+    return _wallCount > 0;
+}
+
+bool ODOMETRY::fix(float distance, float angle, float offset, float variance) {
+    float beta = theta + angle;
+    float direction[2] = { cosf(beta), sinf(beta) };
+    float position[2] = { x, y };
+
+    // the wall the sensor looks at is the first one hit by its ray
+    int8_t wall = -1;
+    float range = 0;
+    for(uint8_t i = 0; i < _wallCount; i++) {
+        float d = direction[_walls[i].axis];
+        if(fabsf(d) < 0.5) continue; // more than 60 degrees off the wall normal, echoes are unreliable
+        float t = (_walls[i].position - position[_walls[i].axis]) / d;
+        if((t > 0) && ((wall < 0) || (t < range))) {
+            wall = i;
+            range = t;
+        }
+    }
+    if(wall < 0) return false;
+
+    uint8_t axis = _walls[wall].axis;
+    float d = direction[axis];
+    float dd = (axis == 0) ? -direction[1] : direction[0]; // d(direction[axis]) / d(theta)
+    float gap = _walls[wall].position - position[axis];
+    float h[3] = { 0, 0, -gap * dd / (d * d) };
+    h[axis] = -1 / d;
+
+    float innovation = distance - (range - offset);
+    float ph[3];
+    for(uint8_t i = 0; i < 3; i++) {
+        ph[i] = (covariance[i][0] * h[0]) + (covariance[i][1] * h[1]) + (covariance[i][2] * h[2]);
+    }
+    float innovationVariance = (h[0] * ph[0]) + (h[1] * ph[1]) + (h[2] * ph[2]) + variance;
+    if((innovation * innovation) / innovationVariance > ODOMETRY_GATE) {
+        // inner walls and pillars are not part of the map
+        rejectedFixes++;
+        return false;
+    }
+
+    float k[3] = { ph[0] / innovationVariance, ph[1] / innovationVariance, ph[2] / innovationVariance };
+    x += k[0] * innovation;
+    y += k[1] * innovation;
+    theta += k[2] * innovation;
+    _headingOffset += k[2] * innovation;
+    for(uint8_t i = 0; i < 3; i++) {
+        for(uint8_t j = 0; j < 3; j++) {
+            covariance[i][j] -= k[i] * ph[j];
+        }
+    }
+    acceptedFixes++;
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+/**
+ * Encoder and gyro dead reckoning library
+ * by TerraForce
+*/
+
+#define ODOMETRY_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+
+#define ODOMETRY_FIELD_SIZE         3000    // outer wall square in mm
+#define ODOMETRY_MAX_WALLS          4
+
+// noise model
+#define ODOMETRY_DISTANCE_NOISE     0.05    // variance per mm travelled in mm^2
+#define ODOMETRY_HEADING_NOISE      0.0005  // variance per rad turned in rad^2
+#define ODOMETRY_HEADING_DRIFT      0.00001 // variance per update in rad^2
+#define ODOMETRY_GATE               9.0     // squared mahalanobis distance above which wall fixes are rejected
+
+// field coordinates: origin at the start position, x in start direction, y to the right, theta clockwise
+struct ODOMETRY_WALL {
+    uint8_t axis;   // 0: wall at x = position, 1: wall at y = position
+    float position; // mm
+};
+
+class ODOMETRY {
+    public:
+        void init(float mmPerTick);
+        void reset(int32_t motorTurns, int32_t rotation);
+        void update(int32_t motorTurns, int32_t rotation);
+
+        // outer walls of the field relative to the start position
+        void setField(float frontWall, float outerWall, int8_t side);
+        bool hasField();
+
+        // distance measured by a sensor looking at angle (rad, relative to the heading), mounted offset mm from the center
+        bool fix(float distance, float angle, float offset, float variance);
+
+        float x = 0;            // mm
+        float y = 0;            // mm
+        float theta = 0;        // rad
+        float covariance[3][3] = {};
+        float travelled = 0;    // mm since reset
+        uint32_t acceptedFixes = 0;
+        uint32_t rejectedFixes = 0;
+
+    private:
+        float _mmPerTick = 1;
+        int32_t _lastTurns = 0;
+        float _lastGyro = 0;        // rad
+        float _headingOffset = 0;   // correction of the gyro heading by wall fixes in rad
+        ODOMETRY_WALL _walls[ODOMETRY_MAX_WALLS] = {};
+        uint8_t _wallCount = 0;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include "oled_display.h"
+
+void oledDisplayTaskFunction(void* parameter) {
+    ((OLED_DISPLAY*)parameter)->run();
+}
+
+bool OLED_DISPLAY::init(Adafruit_SSD1306* oled, I2C_BUS* bus, uint8_t address, uint8_t frequency, uint8_t priority, uint8_t core) {
+    _oled = oled;
+    _bus = bus;
+    _address = address;
+    _periodTicks = (configTICK_RATE_HZ / frequency) > 0 ? (configTICK_RATE_HZ / frequency) : 1;
+    for(uint8_t i = 0; i < OLED_DISPLAY_PAGES; i++) {
+        _pageValid[i] = false;
+    }
+    return xTaskCreatePinnedToCore(oledDisplayTaskFunction, "OLED Display Task", 4096, this, priority, &_task, core) == pdPASS;
+}
+
+void OLED_DISPLAY::setState(const OLED_DISPLAY_STATE& state) {
+    portENTER_CRITICAL(&_stateMux);
+    if(memcmp(&_state, &state, sizeof(OLED_DISPLAY_STATE)) != 0) {
+        _state = state;
+        _stateChanged = true;
+    }
+    portEXIT_CRITICAL(&_stateMux);
+}
+
+void OLED_DISPLAY::run() {
+    TickType_t lastWakeTime = xTaskGetTickCount();
+    while(true) {
+        vTaskDelayUntil(&lastWakeTime, _periodTicks);
+
+        // a frame still on the bus is not overwritten, the next period catches up
+        if(!transfersFinished()) continue;
+
+        portENTER_CRITICAL(&_stateMux);
+        bool changed = _stateChanged;
+        OLED_DISPLAY_STATE state = _state;
+        _stateChanged = false;
+        portEXIT_CRITICAL(&_stateMux);
+
+        if(changed) {
+            render(state);
+        }
+        flush();
+    }
+}
+
+void OLED_DISPLAY::render(const OLED_DISPLAY_STATE& state) {
+    char text[12];
+    _oled->clearDisplay();
+    _oled->setCursor(2, 2);
+    _oled->setTextSize(1);
+    _oled->setTextColor(1);
+    snprintf(text, sizeof(text), "%u.%02u V", state.battery / 1000, (state.battery % 1000) / 10);
+    _oled->print(text);
+    _oled->drawRect(80, 2, 40, 8, 1);
+    _oled->fillRect(120, 4, 3, 4, 1);
+    if(state.charge < 100) {
+        _oled->fillRect(120, 5, 2, 2, 0);
+    }
+    _oled->fillRect(80, 2, (uint8_t)((40 * ((state.charge < 100) ? state.charge : 100)) / 100), 8, 1);
+    _oled->setCursor(2, 16);
+    _oled->print(state.text);
+}
+
+// a page with any failed transfer is unknown, it is sent completely with the next flush
+bool OLED_DISPLAY::transfersFinished() {
+    for(uint8_t page = 0; page < OLED_DISPLAY_PAGES; page++) {
+        for(uint8_t i = 0; i < OLED_DISPLAY_TRANSFERS; i++) {
+            if(_transferStatus[page][i] == I2C_Pending) return false;
+        }
+    }
+    for(uint8_t page = 0; page < OLED_DISPLAY_PAGES; page++) {
+        for(uint8_t i = 0; i < OLED_DISPLAY_TRANSFERS; i++) {
+            if(_transferStatus[page][i] == I2C_Failed) {
+                _pageValid[page] = false;
+            }
+            _transferStatus[page][i] = I2C_Idle;
+        }
+    }
+    return true;
+}
+
+// only the changed column range of each page is sent
+void OLED_DISPLAY::flush() {
+    uint8_t* buffer = _oled->getBuffer();
+    bool changed = false;
+    for(uint8_t page = 0; page < OLED_DISPLAY_PAGES; page++) {
+        uint8_t* rendered = buffer + (page * OLED_DISPLAY_WIDTH);
+        uint8_t* shown = _shown + (page * OLED_DISPLAY_WIDTH);
+        int16_t first = 0;
+        int16_t last = OLED_DISPLAY_WIDTH - 1;
+        if(_pageValid[page]) {
+            while((first < OLED_DISPLAY_WIDTH) && (rendered[first] == shown[first])) first++;
+            if(first == OLED_DISPLAY_WIDTH) continue;
+            while(rendered[last] == shown[last]) last--;
+        }
+
+        changed = true;
+        const uint8_t commands[] = { 0x00, 0x22, page, page, 0x21, (uint8_t)first, (uint8_t)last };
+        volatile uint8_t* status = _transferStatus[page];
+        bool sent = _bus->write(_address, commands, sizeof(commands), I2C_Display, status++);
+        uint8_t chunk[I2C_BUS_MAX_WRITE] = { 0x40 };
+        for(int16_t column = first; sent && (column <= last); column += I2C_BUS_MAX_WRITE - 1) {
+            uint8_t length = ((last + 1 - column) < (I2C_BUS_MAX_WRITE - 1)) ? (last + 1 - column) : (I2C_BUS_MAX_WRITE - 1);
+            memcpy(chunk + 1, rendered + column, length);
+            sent = _bus->write(_address, chunk, length + 1, I2C_Display, status++);
+            bytes += length;
+        }
+
+        // a dropped chunk leaves the page unknown, it is sent completely next time,
+        // chunks failing on the bus are found by transfersFinished
+        _pageValid[page] = sent;
+        memcpy(shown, rendered, OLED_DISPLAY_WIDTH);
+    }
+    frames += changed;
+}
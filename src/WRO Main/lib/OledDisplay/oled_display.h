@@ -0,0 +1,56 @@
+#ifndef OLED_DISPLAY_H
+#define OLED_DISPLAY_H
+
+/**
+ * Background SSD1306 display library for ESP32 MCUs
+ * by TerraForce
+*/
+
+#define OLED_DISPLAY_LIB_VERSION "1.0.0"
+
+#include <Arduino.h>
+#include <Adafruit_SSD1306.h>
+#include "i2c_bus.h"
+
+#define OLED_DISPLAY_WIDTH      128
+#define OLED_DISPLAY_PAGES      4       // 8 pixel rows each
+#define OLED_DISPLAY_TEXT_SIZE  22
+#define OLED_DISPLAY_TRANSFERS  (1 + (OLED_DISPLAY_WIDTH + I2C_BUS_MAX_WRITE - 2) / (I2C_BUS_MAX_WRITE - 1)) // command and data chunks of a page
+
+// everything shown, filled by the caller and copied on set
+struct OLED_DISPLAY_STATE {
+    uint16_t battery;                   // mV
+    uint8_t charge;                     // %
+    char text[OLED_DISPLAY_TEXT_SIZE];  // second line
+};
+
+class OLED_DISPLAY {
+    public:
+        // oled must be started, afterwards only its buffer is used
+        bool init(Adafruit_SSD1306* oled, I2C_BUS* bus, uint8_t address, uint8_t frequency, uint8_t priority, uint8_t core);
+        void setState(const OLED_DISPLAY_STATE& state);
+
+        uint32_t frames = 0;    // frames with changes
+        uint32_t bytes = 0;     // display data bytes sent
+
+    private:
+        friend void oledDisplayTaskFunction(void* parameter);
+        void run();
+        void render(const OLED_DISPLAY_STATE& state);
+        bool transfersFinished();
+        void flush();
+
+        Adafruit_SSD1306* _oled = NULL;
+        I2C_BUS* _bus = NULL;
+        uint8_t _address = 0x3c;
+        TickType_t _periodTicks = 1;
+        TaskHandle_t _task = NULL;
+        OLED_DISPLAY_STATE _state = {};
+        bool _stateChanged = true;
+        portMUX_TYPE _stateMux = portMUX_INITIALIZER_UNLOCKED;
+        uint8_t _shown[OLED_DISPLAY_PAGES * OLED_DISPLAY_WIDTH] = {}; // frame on the display
+        bool _pageValid[OLED_DISPLAY_PAGES] = {};
+        volatile uint8_t _transferStatus[OLED_DISPLAY_PAGES][OLED_DISPLAY_TRANSFERS] = {};
+};
+
+#endif
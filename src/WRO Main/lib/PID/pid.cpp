@@ -0,0 +1,47 @@
+#include "pid.h"
+
+void PID::init(PID_GAINS gains, float outputMin, float outputMax, float rateLimit) {
+    this->gains = gains;
+    this->rateLimit = rateLimit;
+    _outputMin = outputMin;
+    _outputMax = outputMax;
+    reset();
+}
+
+float PID::update(float error, float dt) {
+    if(dt <= 0) return output;
+
+    float derivative = _hasLastError ? ((error - _lastError) / dt) : 0;
+    _lastError = error;
+    _hasLastError = true;
+
+    float unsaturated = (gains.kp * error) + _integral + (gains.kd * derivative);
+
+    // anti-windup: only integrate while the output is not pushed further into saturation
+    float integral = _integral + (gains.ki * error * dt);
+    if(!((unsaturated >= _outputMax) && (error > 0)) && !((unsaturated <= _outputMin) && (error < 0))) {
+        _integral = (integral > _outputMax) ? _outputMax : ((integral < _outputMin) ? _outputMin : integral);
+    }
+
+    float target = (gains.kp * error) + _integral + (gains.kd * derivative);
+    target = (target > _outputMax) ? _outputMax : ((target < _outputMin) ? _outputMin : target);
+
+    if(rateLimit > 0) {
+        float maxChange = rateLimit * dt;
+        if(target > output + maxChange) {
+            target = output + maxChange;
+        }
+        else if(target < output - maxChange) {
+            target = output - maxChange;
+        }
+    }
+    output = target;
+    return output;
+}
+
+void PID::reset() {
+    _integral = 0;
+    _lastError = 0;
+    _hasLastError = false;
+    output = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef PID_H
+#define PID_H
+
+/**
+ * PID controller library
+ * by TerraForce
+*/
+
+#define PID_LIB_VERSION "1.0.0"
+
+struct PID_GAINS {
+    float kp;
+    float ki;
+    float kd;
+};
+
+class PID {
+    public:
+        void init(PID_GAINS gains, float outputMin, float outputMax, float rateLimit = 0);
+        float update(float error, float dt); // dt in s
+        void reset();
+
+        PID_GAINS gains = {};
+        float rateLimit = 0; // maximum output change per s, 0 = unlimited
+        float output = 0;
+
+    private:
+        float _integral = 0;
+        float _lastError = 0;
+        bool _hasLastError = false;
+        float _outputMin = 0;
+        float _outputMax = 0;
+};
+
+#endif
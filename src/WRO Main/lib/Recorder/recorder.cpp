@@ -0,0 +1,54 @@
+#include "recorder.h"
+#include <string.h>
+
+static size_t recordSize(uint8_t type) {
+    switch(type) {
+        case RECORD_Config:     return sizeof(RECORD_CONFIG);
+        case RECORD_Start:      return sizeof(RECORD_START);
+        case RECORD_Ultrasonic: return sizeof(RECORD_ULTRASONIC);
+        case RECORD_Tick:       return sizeof(RECORD_TICK);
+        default:                return 0;
+    }
+}
+
+// only the used part of the union is sent, led by a delimiter like telemetry frames
+size_t recordEncode(const RECORD& record, uint8_t* frame) {
+    frame[0] = FRAMING_DELIMITER;
+    return 1 + frameEncode((const uint8_t*)&record, 1 + recordSize(record.type), frame + 1);
+}
+
+bool recordDecode(const uint8_t* frame, size_t length, RECORD* record) {
+    uint8_t payload[sizeof(RECORD) + 2];
+    size_t payloadLength = frameDecode(frame, length, payload, sizeof(payload));
+    if((payloadLength == 0) || (payloadLength != 1 + recordSize(payload[0]))) return false;
+    memset(record, 0, sizeof(RECORD));
+    memcpy(record, payload, payloadLength);
+    return true;
+}
+
+void recordSnapshot(const RECORD_TICK& tick, ULTRASONIC& ultrasonic, SENSOR_SNAPSHOT* sensors) {
+    *sensors = {};
+    sensors->time = tick.time;
+    for(uint8_t i = 0; i < 6; i++) {
+        sensors->distance[i] = ultrasonic.distance(i, tick.time);
+    }
+    sensors->updated = ultrasonic.takeUpdated();
+    sensors->rotation = tick.rotation;
+    sensors->object.available = tick.object & 1;
+    sensors->object.color = (tick.object >> 1) & 1;
+    sensors->object.direction = (tick.object >> 2) & 1;
+    sensors->object.angle = tick.object >> 3;
+    sensors->rotationAge = tick.rotationAge;
+    sensors->objectAge = tick.objectAge;
+    // the last object of a camera that stopped sending is not there anymore
+    if(tick.objectAge > DRIVE_MAX_OBJECT_AGE) {
+        sensors->object = {};
+    }
+    sensors->motorTurns = tick.motorTurns;
+    sensors->motorRpm = tick.motorRpm;
+    sensors->battery = tick.battery;
+}
+
+uint8_t recordObject(SENSOR_SNAPSHOT::OBJECT_DATA object) {
+    return object.available | (object.color << 1) | (object.direction << 2) | (object.angle << 3);
+}
@@ -0,0 +1,82 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+/**
+ * Drive control input recording library
+ * by TerraForce
+*/
+
+#define RECORDER_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+#include <stddef.h>
+#include "framing.h"
+#include "drive_control.h"
+#include "ultrasonic.h"
+
+#define RECORD_VERSION      3
+#define RECORD_MAX_FRAME    (1 + FRAMING_MAX_ENCODED(sizeof(RECORD)))
+
+enum RECORD_TYPES {
+    RECORD_Config,      // once at boot, before any ultrasonic sample
+    RECORD_Start,       // drive control initialised
+    RECORD_Ultrasonic,  // every raw ultrasonic sample
+    RECORD_Tick         // every control tick
+};
+
+#pragma pack(push, 1)
+struct RECORD_CONFIG {
+    uint8_t version;
+    uint8_t filterSize;
+    uint16_t outlierThreshold;
+    uint16_t maxAge;
+    uint16_t controlFrequency;
+};
+
+struct RECORD_ULTRASONIC {
+    uint32_t time;      // ms
+    uint8_t sensor;
+    uint16_t distance;  // mm
+    uint8_t valid;
+};
+
+// inputs of a control tick besides the ultrasonic filter and the resulting actuator commands
+struct RECORD_TICK {
+    uint32_t time;      // ms
+    int32_t rotation;
+    uint8_t object;     // bit 0 available, bit 1 color, bit 2 direction, bits 3-7 angle
+    uint16_t rotationAge;
+    uint16_t objectAge;
+    int32_t motorTurns;
+    int16_t motorRpm;
+    uint16_t battery;
+    int8_t motor;
+    int8_t steering;
+    uint16_t dropped;   // records lost on the robot so far, the replay is not exact after a change
+};
+
+struct RECORD_START {
+    RECORD_TICK tick;
+    uint8_t course;
+    uint8_t maxSpeed;
+};
+
+struct RECORD {
+    uint8_t type;
+    union {
+        RECORD_CONFIG config;
+        RECORD_START start;
+        RECORD_ULTRASONIC ultrasonic;
+        RECORD_TICK tick;
+    };
+};
+#pragma pack(pop)
+
+size_t recordEncode(const RECORD& record, uint8_t* frame);
+bool recordDecode(const uint8_t* frame, size_t length, RECORD* record);
+
+// the snapshot the drive control sees, built the same way on the robot and in the replay
+void recordSnapshot(const RECORD_TICK& tick, ULTRASONIC& ultrasonic, SENSOR_SNAPSHOT* sensors);
+uint8_t recordObject(SENSOR_SNAPSHOT::OBJECT_DATA object);
+
+#endif
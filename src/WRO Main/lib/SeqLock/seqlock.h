@@ -0,0 +1,55 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+/**
+ * Double buffered sequence lock library
+ * by TerraForce
+ *
+ * One writer publishes complete values, any number of readers take coherent copies.
+ * The writer never waits, it fills the buffer the readers do not use and publishes it
+ * with the sequence counter. A reader only retries if two writes overlap its copy.
+*/
+
+#define SEQLOCK_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+template<typename T> class SEQLOCK {
+    public:
+        // single writer, e.g. the I2C slave callback
+        void write(const T& value) {
+            uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+            _sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            copy(&_buffers[((sequence >> 1) + 1) & 1], &value);
+            _sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        // returns the sequence of the copy, it counts up by 2 with every write
+        uint32_t read(T* value) const {
+            while(true) {
+                uint32_t sequence = _sequence.load(std::memory_order_acquire);
+                copy(value, &_buffers[(sequence >> 1) & 1]);
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                // the buffer is reused by the second write after the published one
+                uint32_t published = sequence & ~1UL;
+                if(_sequence.load(std::memory_order_relaxed) - published <= 2) return published;
+            }
+        }
+
+    private:
+        // byte wise, the compiler must not assume the source stays unchanged
+        static void copy(volatile T* destination, const volatile T* source) {
+            for(size_t i = 0; i < sizeof(T); i++) {
+                ((volatile uint8_t*)destination)[i] = ((const volatile uint8_t*)source)[i];
+            }
+        }
+
+        volatile T _buffers[2] = {};
+        std::atomic<uint32_t> _sequence{0};
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "sequencer.h"
+
+bool SEQUENCER::add(SEQUENCER_STEP step) {
+    if(_count >= SEQUENCER_MAX_STEPS) return false;
+    _steps[(_first + _count) % SEQUENCER_MAX_STEPS] = step;
+    _count++;
+    return true;
+}
+
+void SEQUENCER::clear() {
+    _first = 0;
+    _count = 0;
+    _running = false;
+}
+
+void SEQUENCER::update(uint32_t now, int32_t motorTurns, int32_t rotation) {
+    // every step runs at most once per update, so an update has a bounded cost
+    for(uint8_t i = 0; (i < SEQUENCER_MAX_STEPS) && (_count > 0); i++) {
+        if(!_running) {
+            _running = true;
+            _startTime = now;
+            _startTurns = motorTurns;
+            _startRotation = rotation;
+            if(_steps[_first].action != NULL) {
+                _steps[_first].action(context);
+            }
+        }
+        if(!_running || !finished(now, motorTurns, rotation)) return;
+        _running = false;
+        _first = (_first + 1) % SEQUENCER_MAX_STEPS;
+        _count--;
+    }
+}
+
+bool SEQUENCER::busy() {
+    return _count > 0;
+}
+
+bool SEQUENCER::finished(uint32_t now, int32_t motorTurns, int32_t rotation) {
+    const SEQUENCER_STEP& step = _steps[_first];
+    if((step.duration == 0) && (step.distance == 0) && (step.angle == 0)) return true;
+    if((step.duration != 0) && (now - _startTime >= step.duration)) return true;
+    if(step.distance != 0) {
+        int32_t travelled = motorTurns - _startTurns;
+        if((uint32_t)((travelled < 0) ? -travelled : travelled) >= step.distance) return true;
+    }
+    if(step.angle != 0) {
+        int32_t change = rotation - _startRotation;
+        if(((change < 0) ? -change : change) >= ((step.angle < 0) ? -step.angle : step.angle)) return true;
+    }
+    return false;
+}
@@ -0,0 +1,44 @@
+#ifndef SEQUENCER_H
+#define SEQUENCER_H
+
+/**
+ * Non-blocking action sequencer library
+ * by TerraForce
+*/
+
+#define SEQUENCER_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SEQUENCER_MAX_STEPS 8
+
+struct SEQUENCER_STEP {
+    void (*action)(void* context);  // called once when the step starts, may be NULL
+    uint32_t duration;              // step length in ms, 0 = no time limit
+    uint32_t distance;              // ends the step early after this encoder distance in 1/8 motor turns in either direction, 0 = unused
+    int32_t angle;                  // ends the step early after this rotation change in 1/10 degrees, 0 = unused
+};
+
+class SEQUENCER {
+    public:
+        bool add(SEQUENCER_STEP step);
+        void clear();
+        void update(uint32_t now, int32_t motorTurns, int32_t rotation);
+        bool busy();
+
+        void* context = NULL; // passed to the step actions
+
+    private:
+        bool finished(uint32_t now, int32_t motorTurns, int32_t rotation);
+
+        SEQUENCER_STEP _steps[SEQUENCER_MAX_STEPS] = {};
+        uint8_t _first = 0;
+        uint8_t _count = 0;
+        bool _running = false;
+        uint32_t _startTime = 0;
+        int32_t _startTurns = 0;
+        int32_t _startRotation = 0;
+};
+
+#endif
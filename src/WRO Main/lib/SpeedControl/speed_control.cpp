@@ -0,0 +1,59 @@
+#include "speed_control.h"
+#include <math.h>
+
+void SPEED_CONTROLLER::init(float mmPerTick, float feedForward, int8_t maxCommand) {
+    _mmPerTick = mmPerTick;
+    this->feedForward = feedForward;
+    _maxCommand = maxCommand;
+    pid.init({ 0.005, 0.01, 0 }, -5, 5);
+    reset();
+}
+
+void SPEED_CONTROLLER::reset() {
+    pid.reset();
+    _sampleCount = 0;
+    _nextSample = 0;
+    speed = 0;
+}
+
+int8_t SPEED_CONTROLLER::update(uint32_t time, int32_t motorTurns, int16_t motorRpm, float voltage, float target, bool closedLoop) {
+    float dt = (time - _lastTime) / 1000.0;
+    _lastTime = time;
+
+    // the encoder is polled slower than the control rate, only changes carry timing information
+    SPEED_SAMPLE& newest = _samples[(_nextSample + SPEED_WINDOW_SIZE - 1) % SPEED_WINDOW_SIZE];
+    if((_sampleCount > 0) && (time - newest.time > SPEED_TIMEOUT)) {
+        _samples[0] = newest;
+        _sampleCount = 1;
+        _nextSample = 1;
+        speed = 0;
+    }
+    if((_sampleCount == 0) || (motorTurns != newest.turns)) {
+        _samples[_nextSample] = { time, motorTurns };
+        _nextSample = (_nextSample + 1) % SPEED_WINDOW_SIZE;
+        if(_sampleCount < SPEED_WINDOW_SIZE) _sampleCount++;
+
+        SPEED_SAMPLE& first = _samples[(_nextSample + SPEED_WINDOW_SIZE - _sampleCount) % SPEED_WINDOW_SIZE];
+        if((_sampleCount > 1) && (time > first.time)) {
+            speed = (fabsf((float)(motorTurns - first.turns)) * _mmPerTick * 1000) / (time - first.time);
+        }
+    }
+    // the encoder period reacts within one tick of the encoder
+    if(motorRpm != 0) {
+        speed = fabsf((float)motorRpm) * SPEED_TICKS_PER_TURN * _mmPerTick / 60;
+    }
+
+    if(target == 0) {
+        pid.reset();
+        return 0;
+    }
+
+    // battery voltage sets the motor speed per command step
+    float magnitude = fabsf(target);
+    float command = magnitude / (feedForward * ((voltage > 1) ? voltage : SPEED_NOMINAL_VOLTAGE));
+    if(closedLoop && (dt > 0)) {
+        command += pid.update(magnitude - speed, dt);
+    }
+    command = (command > _maxCommand) ? _maxCommand : command;
+    return (int8_t)lroundf((target < 0) ? -command : command);
+}
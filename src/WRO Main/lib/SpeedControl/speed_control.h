@@ -0,0 +1,46 @@
+#ifndef SPEED_CONTROL_H
+#define SPEED_CONTROL_H
+
+/**
+ * Closed loop wheel speed control library
+ * by TerraForce
+*/
+
+#define SPEED_CONTROL_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+#include "pid.h"
+
+#define SPEED_WINDOW_SIZE       8       // encoder changes the speed is measured over without an rpm
+#define SPEED_TICKS_PER_TURN    8       // encoder ticks per motor turn
+#define SPEED_TIMEOUT           150     // no encoder change for this long means standstill in ms
+#define SPEED_NOMINAL_VOLTAGE   7.8     // used while the battery voltage is unknown in V
+
+struct SPEED_SAMPLE {
+    uint32_t time;  // ms
+    int32_t turns;  // encoder ticks
+};
+
+class SPEED_CONTROLLER {
+    public:
+        void init(float mmPerTick, float feedForward, int8_t maxCommand = 15);
+        void reset();
+
+        // target in mm/s, returns the motor command, only the feed forward is used without closedLoop
+        // a motorRpm of 0 falls back to the speed over the last encoder changes
+        int8_t update(uint32_t time, int32_t motorTurns, int16_t motorRpm, float voltage, float target, bool closedLoop);
+
+        PID pid;                // speed error in mm/s -> motor command correction
+        float feedForward = 1;  // speed per motor command step and battery volt in mm/s
+        float speed = 0;        // measured speed in mm/s
+
+    private:
+        SPEED_SAMPLE _samples[SPEED_WINDOW_SIZE] = {};
+        uint8_t _sampleCount = 0;
+        uint8_t _nextSample = 0;
+        float _mmPerTick = 1;
+        int8_t _maxCommand = 15;
+        uint32_t _lastTime = 0;
+};
+
+#endif
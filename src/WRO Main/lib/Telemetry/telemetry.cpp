@@ -0,0 +1,24 @@
+#include "telemetry.h"
+#include <string.h>
+
+#define TELEMETRY_FIELD_ENTRY(type, name) { #name, offsetof(TELEMETRY_SAMPLE, name), sizeof(type), ((type)-1) < 0 },
+const TELEMETRY_FIELD telemetryFields[] = {
+    TELEMETRY_FIELD_LIST(TELEMETRY_FIELD_ENTRY)
+};
+#undef TELEMETRY_FIELD_ENTRY
+
+const uint8_t telemetryFieldCount = sizeof(telemetryFields) / sizeof(TELEMETRY_FIELD);
+
+// the leading delimiter ends text logging in front of the frame, so the frame itself stays intact
+size_t telemetryEncode(const TELEMETRY_SAMPLE& sample, uint8_t* frame) {
+    frame[0] = FRAMING_DELIMITER;
+    return 1 + frameEncode((const uint8_t*)&sample, sizeof(TELEMETRY_SAMPLE), frame + 1);
+}
+
+bool telemetryDecode(const uint8_t* frame, size_t length, TELEMETRY_SAMPLE* sample) {
+    uint8_t payload[sizeof(TELEMETRY_SAMPLE) + 2];
+    if(frameDecode(frame, length, payload, sizeof(payload)) != sizeof(TELEMETRY_SAMPLE)) return false;
+    if(payload[0] != TELEMETRY_VERSION) return false;
+    memcpy(sample, payload, sizeof(TELEMETRY_SAMPLE));
+    return true;
+}
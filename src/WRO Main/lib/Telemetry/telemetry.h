@@ -0,0 +1,66 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+/**
+ * Binary telemetry library
+ * by TerraForce
+*/
+
+#define TELEMETRY_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+#include <stddef.h>
+#include "framing.h"
+
+#define TELEMETRY_VERSION       1
+#define TELEMETRY_MAX_FRAME     (1 + FRAMING_MAX_ENCODED(sizeof(TELEMETRY_SAMPLE)))
+
+// type, name, one sample per control tick
+#define TELEMETRY_FIELD_LIST(FIELD) \
+    FIELD(uint8_t,  version) \
+    FIELD(uint16_t, sequence) \
+    FIELD(uint32_t, time)       /* ms */ \
+    FIELD(uint16_t, distance0)  /* ultrasonic distances in mm, sensor order of UltraSonicPositions */ \
+    FIELD(uint16_t, distance1) \
+    FIELD(uint16_t, distance2) \
+    FIELD(uint16_t, distance3) \
+    FIELD(uint16_t, distance4) \
+    FIELD(uint16_t, distance5) \
+    FIELD(int32_t,  rotation)   /* 1/10 degrees */ \
+    FIELD(uint8_t,  object)     /* bit 0 available, bit 1 color, bit 2 direction, bits 3-7 angle */ \
+    FIELD(int8_t,   speed) \
+    FIELD(int8_t,   steering) \
+    FIELD(int8_t,   motor) \
+    FIELD(int16_t,  velocity)   /* target in mm/s */ \
+    FIELD(int16_t,  measured)   /* measured in mm/s */ \
+    FIELD(uint8_t,  direction) \
+    FIELD(uint8_t,  state) \
+    FIELD(uint8_t,  curveCount) \
+    FIELD(int32_t,  motorTurns) \
+    FIELD(uint16_t, battery)    /* mV */ \
+    FIELD(int16_t,  x)          /* odometry in mm */ \
+    FIELD(int16_t,  y) \
+    FIELD(int16_t,  heading)    /* odometry in 1/10 degrees */
+
+#define TELEMETRY_MEMBER(type, name) type name;
+#pragma pack(push, 1)
+struct TELEMETRY_SAMPLE {
+    TELEMETRY_FIELD_LIST(TELEMETRY_MEMBER)
+};
+#pragma pack(pop)
+#undef TELEMETRY_MEMBER
+
+struct TELEMETRY_FIELD {
+    const char* name;
+    uint8_t offset;
+    uint8_t size;
+    bool isSigned;
+};
+
+extern const TELEMETRY_FIELD telemetryFields[];
+extern const uint8_t telemetryFieldCount;
+
+size_t telemetryEncode(const TELEMETRY_SAMPLE& sample, uint8_t* frame);
+bool telemetryDecode(const uint8_t* frame, size_t length, TELEMETRY_SAMPLE* sample);
+
+#endif
@@ -0,0 +1,79 @@
+#include "trace.h"
+#include <string.h>
+
+#define TRACE_EVENT_INFO_ENTRY(id, name, arg0, arg1) { name, { arg0, arg1 } },
+const TRACE_EVENT_INFO traceEvents[TRACE_Events] = {
+    TRACE_EVENT_LIST(TRACE_EVENT_INFO_ENTRY)
+};
+#undef TRACE_EVENT_INFO_ENTRY
+
+void TRACE::init(uint32_t (*clock)()) {
+    _clock = clock;
+    _tail = _head.load(std::memory_order_acquire);
+    lost = 0;
+}
+
+void TRACE::log(uint16_t event, int32_t arg0, int32_t arg1) {
+    uint32_t index = _head.fetch_add(1, std::memory_order_relaxed);
+    SLOT& slot = _slots[index & (TRACE_RING_SIZE - 1)];
+    slot.commit.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.record.time = (_clock != NULL) ? _clock() : 0;
+    slot.record.event = event;
+    slot.record.sequence = (uint16_t)index;
+    slot.record.args[0] = arg0;
+    slot.record.args[1] = arg1;
+    slot.commit.store(index + 1, std::memory_order_release);
+}
+
+bool TRACE::read(TRACE_RECORD* record) {
+    while(true) {
+        uint32_t head = _head.load(std::memory_order_acquire);
+        if(head - _tail > TRACE_RING_SIZE) {
+            lost += head - _tail - TRACE_RING_SIZE;
+            _tail = head - TRACE_RING_SIZE;
+        }
+        if(_tail == head) return false;
+
+        SLOT& slot = _slots[_tail & (TRACE_RING_SIZE - 1)];
+        uint32_t commit = slot.commit.load(std::memory_order_acquire);
+        if(commit == 0) return false; // being written, possibly by a writer that already lapped the reader
+        if(commit != _tail + 1) {
+            // the slot was overwritten by a newer record
+            if((int32_t)(commit - (_tail + 1)) > 0) {
+                lost++;
+                _tail++;
+                continue;
+            }
+            return false;
+        }
+        *record = slot.record;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        bool unchanged = slot.commit.load(std::memory_order_relaxed) == _tail + 1;
+        _tail++;
+        if(unchanged) return true;
+        lost++;
+    }
+}
+
+void TRACE::frame(const TRACE_RECORD& record, uint8_t* frame) {
+    frame[0] = TRACE_SYNC[0];
+    frame[1] = TRACE_SYNC[1];
+    memcpy(frame + 2, &record, sizeof(TRACE_RECORD));
+    uint8_t checksum = 0;
+    for(uint8_t i = 0; i < sizeof(TRACE_RECORD); i++) {
+        checksum += frame[2 + i];
+    }
+    frame[2 + sizeof(TRACE_RECORD)] = checksum;
+}
+
+bool TRACE::unframe(const uint8_t* frame, TRACE_RECORD* record) {
+    if((frame[0] != TRACE_SYNC[0]) || (frame[1] != TRACE_SYNC[1])) return false;
+    uint8_t checksum = 0;
+    for(uint8_t i = 0; i < sizeof(TRACE_RECORD); i++) {
+        checksum += frame[2 + i];
+    }
+    if(checksum != frame[2 + sizeof(TRACE_RECORD)]) return false;
+    memcpy(record, frame + 2, sizeof(TRACE_RECORD));
+    return record->event < TRACE_Events;
+}
@@ -0,0 +1,75 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/**
+ * Binary ring buffer trace library
+ * by TerraForce
+*/
+
+#define TRACE_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#define TRACE_RING_SIZE     1024    // records, power of two
+#define TRACE_SYNC          (uint8_t[]){ 0xa5, 0x5a }
+#define TRACE_FRAME_SIZE    (2 + sizeof(TRACE_RECORD) + 1) // sync, record, checksum
+
+// event id, name, argument names
+#define TRACE_EVENT_LIST(EVENT) \
+    EVENT(TRACE_Servo,          "servo",        "index",        "value") \
+    EVENT(TRACE_Light,          "light",        "index",        "state") \
+    EVENT(TRACE_DriveState,     "drive_state",  "direction",    "state") \
+    EVENT(TRACE_Curve,          "curve",        "count",        "direction") \
+    EVENT(TRACE_Mark,           "mark",         "a",            "b")
+
+#define TRACE_EVENT_ID(id, name, arg0, arg1) id,
+enum TRACE_EVENTS {
+    TRACE_EVENT_LIST(TRACE_EVENT_ID)
+    TRACE_Events
+};
+#undef TRACE_EVENT_ID
+
+struct TRACE_RECORD {
+    uint32_t time;      // µs
+    uint16_t event;
+    uint16_t sequence;  // lower bits of the record index, gaps show lost records
+    int32_t args[2];
+};
+
+struct TRACE_EVENT_INFO {
+    const char* name;
+    const char* args[2];
+};
+
+extern const TRACE_EVENT_INFO traceEvents[TRACE_Events];
+
+class TRACE {
+    public:
+        void init(uint32_t (*clock)());
+
+        // lock free for any number of writers, the oldest records are overwritten
+        void log(uint16_t event, int32_t arg0 = 0, int32_t arg1 = 0);
+
+        // single reader, false if no record is ready
+        bool read(TRACE_RECORD* record);
+
+        static void frame(const TRACE_RECORD& record, uint8_t* frame);
+        static bool unframe(const uint8_t* frame, TRACE_RECORD* record);
+
+        uint32_t lost = 0; // records overwritten before they were read
+
+    private:
+        struct SLOT {
+            std::atomic<uint32_t> commit; // index + 1 once written, 0 while a writer is busy
+            TRACE_RECORD record;
+        };
+
+        SLOT _slots[TRACE_RING_SIZE] = {};
+        std::atomic<uint32_t> _head = { 0 };
+        uint32_t _tail = 0;
+        uint32_t (*_clock)() = NULL;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "ultrasonic.h"
+
+void ULTRASONIC::init(uint8_t filterSize, uint16_t outlierThreshold, uint16_t maxAge) {
+    _filterSize = (filterSize < 1) ? 1 : ((filterSize > ULTRASONIC_MAX_FILTER_SIZE) ? ULTRASONIC_MAX_FILTER_SIZE : filterSize);
+    _outlierThreshold = outlierThreshold;
+    _maxAge = maxAge;
+    for(uint8_t i = 0; i < ULTRASONIC_SENSOR_COUNT; i++) {
+        for(uint8_t j = 0; j < ULTRASONIC_MAX_FILTER_SIZE; j++) {
+            _samples[i][j] = {};
+        }
+        _measurements[i] = {};
+        _nextSample[i] = 0;
+        outliers[i] = 0;
+        timeouts[i] = 0;
+    }
+    _updated = 0;
+}
+
+void ULTRASONIC::add(uint8_t sensor, uint16_t distance, uint32_t timestamp, bool valid) {
+    if(sensor >= ULTRASONIC_SENSOR_COUNT) return;
+    ULTRASONIC_MEASUREMENT& measurement = _measurements[sensor];
+
+    // spikes stay in the window, so the median only follows them if they persist
+    if(!valid) {
+        timeouts[sensor]++;
+    }
+    else if(measurement.valid && (((distance > measurement.distance) ? (distance - measurement.distance) : (measurement.distance - distance)) > _outlierThreshold)) {
+        outliers[sensor]++;
+    }
+
+    _samples[sensor][_nextSample[sensor]] = { distance, timestamp, valid };
+    _nextSample[sensor] = (_nextSample[sensor] + 1) % _filterSize;
+
+    bool medianValid = false;
+    uint16_t filtered = median(sensor, &medianValid);
+    if(!medianValid) {
+        measurement.valid = false;
+        measurement.rate = 0;
+        return;
+    }
+
+    if(measurement.valid && valid && (timestamp > measurement.timestamp)) {
+        int32_t change = (int32_t)filtered - measurement.distance;
+        if((change > _outlierThreshold) || (change < -_outlierThreshold)) {
+            // step change (e.g. wall ends), not a movement
+            measurement.rate = 0;
+        }
+        else {
+            int32_t rate = (change * 1000) / (int32_t)(timestamp - measurement.timestamp);
+            measurement.rate = (int16_t)((measurement.rate + rate) / 2);
+        }
+    }
+    else if(!measurement.valid) {
+        measurement.rate = 0;
+    }
+
+    measurement.distance = filtered;
+    measurement.valid = true;
+    if(valid) {
+        measurement.timestamp = timestamp;
+        _updated |= 1 << sensor;
+    }
+}
+
+ULTRASONIC_MEASUREMENT ULTRASONIC::get(uint8_t sensor) {
+    if(sensor >= ULTRASONIC_SENSOR_COUNT) return {};
+    return _measurements[sensor];
+}
+
+uint16_t ULTRASONIC::distance(uint8_t sensor, uint32_t now) {
+    if(sensor >= ULTRASONIC_SENSOR_COUNT) return 0;
+    ULTRASONIC_MEASUREMENT& measurement = _measurements[sensor];
+    if(!measurement.valid) return 0;
+    uint32_t age = (now > measurement.timestamp) ? (now - measurement.timestamp) : 0;
+    if(age > _maxAge) return 0;
+    int32_t compensated = measurement.distance + ((int32_t)measurement.rate * (int32_t)age) / 1000;
+    return (uint16_t)((compensated < 1) ? 1 : ((compensated > 0xFFFF) ? 0xFFFF : compensated));
+}
+
+uint8_t ULTRASONIC::takeUpdated() {
+    uint8_t updated = _updated;
+    _updated = 0;
+    return updated;
+}
+
+uint16_t ULTRASONIC::median(uint8_t sensor, bool* valid) {
+    uint16_t values[ULTRASONIC_MAX_FILTER_SIZE];
+    uint8_t count = 0;
+    for(uint8_t i = 0; i < _filterSize; i++) {
+        if(_samples[sensor][i].valid) {
+            uint16_t value = _samples[sensor][i].distance;
+            uint8_t j = count;
+            while((j > 0) && (values[j - 1] > value)) {
+                values[j] = values[j - 1];
+                j--;
+            }
+            values[j] = value;
+            count++;
+        }
+    }
+    *valid = count > 0;
+    return (count > 0) ? values[(count - 1) / 2] : 0;
+}
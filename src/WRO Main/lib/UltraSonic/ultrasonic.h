@@ -0,0 +1,53 @@
+#ifndef ULTRASONIC_H
+#define ULTRASONIC_H
+
+/**
+ * Ultrasonic measurement library
+ * by TerraForce
+*/
+
+#define ULTRASONIC_LIB_VERSION "1.0.0"
+
+#include <stdint.h>
+
+#define ULTRASONIC_SENSOR_COUNT     6
+#define ULTRASONIC_MAX_FILTER_SIZE  7
+
+struct ULTRASONIC_SAMPLE {
+    uint16_t distance;  // distance in mm
+    uint32_t timestamp; // time of measurement in ms
+    bool valid;         // false on echo timeout
+};
+
+struct ULTRASONIC_MEASUREMENT {
+    uint16_t distance;  // median filtered distance in mm
+    int16_t rate;       // rate of change in mm/s
+    uint32_t timestamp; // time of the latest valid sample in ms
+    bool valid;         // false if the filter window contains no valid sample
+};
+
+class ULTRASONIC {
+    public:
+        void init(uint8_t filterSize = 3, uint16_t outlierThreshold = 150, uint16_t maxAge = 250);
+        void add(uint8_t sensor, uint16_t distance, uint32_t timestamp, bool valid = true);
+
+        ULTRASONIC_MEASUREMENT get(uint8_t sensor);
+        uint16_t distance(uint8_t sensor, uint32_t now); // velocity compensated distance in mm, 0 if invalid or outdated
+        uint8_t takeUpdated(); // bit mask of the sensors with a valid sample since the last call
+
+        uint32_t outliers[ULTRASONIC_SENSOR_COUNT] = {};
+        uint32_t timeouts[ULTRASONIC_SENSOR_COUNT] = {};
+
+    private:
+        uint16_t median(uint8_t sensor, bool* valid);
+
+        ULTRASONIC_SAMPLE _samples[ULTRASONIC_SENSOR_COUNT][ULTRASONIC_MAX_FILTER_SIZE] = {};
+        ULTRASONIC_MEASUREMENT _measurements[ULTRASONIC_SENSOR_COUNT] = {};
+        uint8_t _nextSample[ULTRASONIC_SENSOR_COUNT] = {};
+        uint8_t _updated = 0;
+        uint8_t _filterSize = 3;
+        uint16_t _outlierThreshold = 150;
+        uint16_t _maxAge = 250;
+};
+
+#endif
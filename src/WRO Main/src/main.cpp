@@ -7,6 +7,37 @@
 
 #define VOLTAGE_BATTERY_CHARGED     8.4
 #define VOLTAGE_BATTERY_EMPTY       7.2
+#define VOLTAGE_PER_ADC_STEP        0.00301513671875
+
+// ultrasonic filter parameters
+#define UltraSonic_Filter_Size          3   // median window in samples
+#define UltraSonic_Outlier_Threshold    150 // mm
+#define UltraSonic_Max_Age              250 // ms
+
+// drive control frequency in Hz
+#define Control_Frequency               200
+#define Power_Poll_Divider              4   // encoders are read every control tick, the ADC values every 4th
+
+// serial debug features
+// #define DEBUG_CONTROL_TIMING
+// #define DEBUG_I2C_BUS
+// #define DEBUG_CAMERA_LINK
+
+// stream binary trace records over the logging serial, otherwise they stay in RAM until "trace dump"
+// #define TRACE_STREAM
+
+// stream a binary telemetry sample every control tick over the logging serial at a higher baud rate
+// #define TELEMETRY
+#define Telemetry_Baud                  921600
+#define Telemetry_TX_Buffer_Size        4096
+
+// record drive control inputs over the logging serial at the telemetry baud rate for the replay of WRO Tools
+// #define RECORDING
+#define Record_Queue_Size               256
+
+#if defined(RECORDING) && defined(TELEMETRY)
+    #error "RECORDING and TELEMETRY share the logging serial"
+#endif
 
 #pragma region includes
 
@@ -14,6 +45,18 @@
 #include <Wire.h>
 #include <Adafruit_SSD1306.h>
 #include <HardwareSerial.h>
+#include "camera_link.h"
+#include "control_task.h"
+#include "drive_control.h"
+#include "hal.h"
+#include "i2c_bus.h"
+#include "oled_display.h"
+#include "recorder.h"
+#include "seqlock.h"
+#include "servo_registers.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "ultrasonic.h"
 
 #pragma endregion includes
 
@@ -37,16 +80,6 @@
 #define Pin_Obstacle_Switch         (uint8_t) 4
 #define Pin_Test_Mode_Switch        (uint8_t) 21
 
-enum UltraSonicPositions {
-    US_LeftFront,
-    US_CenterFront,
-    US_RightFront,
-    US_LeftBack,
-    US_CenterBack,
-    US_RightBack,
-    Variable
-};
-
 // trigger and echo pins of the ultrasonic sensors
 #define Pins_UltraSonic_Trig        (uint8_t[]){ 9, 11, 13, 48, 37, 1 }
 #define Pins_UltraSonic_Echo        (uint8_t[]){ 10, 12, 14, 47, 36, 38 }
@@ -58,64 +91,73 @@ enum UltraSonicPositions {
 
 #pragma region global_properties
 
-struct POWER_SENSOR_DATA {
-    uint16_t analogValues[4]; // 10 bit resolution in 5V
-    uint32_t motorTurns[2]; // 1/8 motor turns
-} powerSensorData = {};
+SERVO_READ_REGISTERS powerSensorData = {};
+
+uint8_t powerSensorBuffer[sizeof(SERVO_READ_REGISTERS)];
+uint8_t powerSensorRegister = SERVO_Reg_Analog; // first register and length of the queued read
+uint8_t powerSensorLength = 0;
+volatile uint8_t powerSensorStatus = I2C_Idle;
+volatile uint8_t servoRegisterStatus = I2C_Idle;
 
 struct CAMERA_SENSOR_DATA {
     int32_t rotation; // rotation in 1/10 degrees
-    struct OBJECT_DATA {
-        uint8_t available   : 1;
-        uint8_t color       : 1;
-        uint8_t direction   : 1;
-        uint8_t angle       : 5;
-    } object;
-} cameraSensorData = {};
+    SENSOR_SNAPSHOT::OBJECT_DATA object;
+    uint32_t rotationTime; // ms of the last heading message
+    uint32_t objectTime; // ms of the last obstacle message
+    CAMERA_HEALTH health;
+};
+
+// the I2C slave callback fills the back buffer and publishes it as a whole
+CAMERA_SENSOR_DATA cameraReceived = {};
+SEQLOCK<CAMERA_SENSOR_DATA> cameraSensorData;
+CAMERA_LINK cameraLink;
 
 TaskHandle_t ultrasonicThread;
-uint16_t ultrasonicDistance[6] = {}; // distance to object in front of ultrasonic sensor in mm
+ULTRASONIC ultrasonic;
+portMUX_TYPE ultrasonicMux = portMUX_INITIALIZER_UNLOCKED;
 
-int8_t servoState[4] = {};
-uint8_t lightState = 0;
+// changed by setServo and setLight, sent as one transaction by sendServoRegisters
+SERVO_WRITE_REGISTERS servoRegisters = {};
+bool servoRegistersChanged = false;
+
+CONTROL_TASK controlTask;
+TRACE trace;
+DRIVE_CONTROL driveControl;
 
 TwoWire i2c_master(0);
-TwoWire i2c_slave(1);
+HAL_I2C i2c_slave(1);
+I2C_BUS i2cBus;
 
 Adafruit_SSD1306 oled(128, 32, &i2c_master, -1, 400000, 400000);
+OLED_DISPLAY oledDisplay;
 
 HardwareSerial loggingSerial(0);
 
-enum Directions {
-    Straight,
-    Left,
-    Right,
-    End
-};
+uint64_t lastDisplayUpdate = 0;
+uint64_t lastDebugOutput = 0;
+
+QueueHandle_t recordQueue = NULL;
+uint16_t recordDropped = 0;
+uint8_t maxSpeed = 11;
 
-enum DriveStates {
-    Unknown,
-    Curve,
-    CurveEnding,
-    GyroCorrection,
-    UltrasonicCorrection,
-    BorderCorrection
+// serial tuning is handed to the control task, which applies it at the start of a tick
+enum TuningChanges {
+    Tuning_Heading      = 1 << 0,
+    Tuning_Offset       = 1 << 1,
+    Tuning_Speed        = 1 << 2,
+    Tuning_TargetOffset = 1 << 3
 };
 
-struct DRIVE_STATE {
-    uint8_t direction   : 2;
-    uint8_t state       : 6;
-} driveState = {};
+struct TUNING {
+    PID_GAINS heading;
+    PID_GAINS offset;
+    PID_GAINS speed;
+    uint16_t targetOffset;
+    uint8_t changed; // bit mask of TuningChanges
+};
 
-uint8_t outsideBorder = Unknown;
-uint8_t outsideBorder2 = Unknown;
-int32_t rotation = 0, antiRotation = 0;
-int32_t targetRotation = 0; // rotation to curve target in 1/10°
-uint64_t lastDisplayUpdate = 0;
-uint8_t curveCount = 0;
-uint16_t startPosDistance = 0;
-int64_t lastCurve = -8000;
-uint8_t maxSpeed = 11;
+TUNING tuning = {};
+portMUX_TYPE tuningMux = portMUX_INITIALIZER_UNLOCKED;
 
 
 #pragma endregion global_properties
@@ -123,15 +165,26 @@ uint8_t maxSpeed = 11;
 
 #pragma region functions
 
-void driveControlStarterCourse();
-void driveControlObstacleCourse();
+void applyTuning();
+void controlLoop();
 void fireUltrasonic(uint8_t num);
-void i2cOnReceiveFunction(int bytes);
-void setServo(uint8_t index, int8_t speed);
+SENSOR_SNAPSHOT getSensorSnapshot();
+void i2cOnReceiveFunction(const uint8_t* data, size_t length);
+void readSerialCommands();
+void record(const RECORD& record);
+void recordThreadFunction(void* parameter);
+void recordTick(const SENSOR_SNAPSHOT& sensors, RECORD_TICK* tick);
+void requestPowerSensorData(uint8_t reg, uint8_t length);
+void sendServoRegisters();
+void sendTelemetry(const SENSOR_SNAPSHOT& sensors);
+void setServo(uint8_t index, int16_t angle);
 void setLight(uint8_t index, bool state);
 void testAlgorithm();
+uint32_t traceClock();
+void traceDump();
+void traceThreadFunction(void* parameter);
 void ultrasonicThreadFunction(void* parameter);
-void updateOLED(String secondLine);
+void updateOLED(const char* secondLine);
 void updateVoltageAndRPM();
 
 #pragma endregion functions
@@ -142,10 +195,40 @@ void updateVoltageAndRPM();
 void setup() {
     
     // start serial for logging
-    loggingSerial.setTxBufferSize(256);
-    loggingSerial.begin(115200, SERIAL_8N1, -1, -1, false, 20000, 112);
+    #if defined(TELEMETRY) || defined(RECORDING)
+        loggingSerial.setTxBufferSize(Telemetry_TX_Buffer_Size);
+        loggingSerial.begin(Telemetry_Baud, SERIAL_8N1, -1, -1, false, 20000, 112);
+    #else
+        loggingSerial.setTxBufferSize(256);
+        loggingSerial.begin(115200, SERIAL_8N1, -1, -1, false, 20000, 112);
+    #endif
     loggingSerial.println(String("\nWRO Main\nVersion: ") + WRO_MAIN_VERSION + "\n");
 
+    // start trace, records are kept in RAM and streamed by a background task if enabled
+    trace.init(traceClock);
+    #ifdef TRACE_STREAM
+        if(xTaskCreatePinnedToCore(traceThreadFunction, "Trace Thread", 4096, NULL, 1, NULL, 1 - xPortGetCoreID()) == pdPASS) {
+            loggingSerial.println("SUCCESS - Trace thread created");
+        }
+        else {
+            loggingSerial.println("FAILED - Trace thread creation failed");
+        }
+    #endif
+
+    // start recording before the first ultrasonic sample, the replay needs the complete filter history
+    #ifdef RECORDING
+        recordQueue = xQueueCreate(Record_Queue_Size, sizeof(RECORD));
+        if((recordQueue != NULL) && (xTaskCreatePinnedToCore(recordThreadFunction, "Record Thread", 4096, NULL, 1, NULL, 1 - xPortGetCoreID()) == pdPASS)) {
+            loggingSerial.println("SUCCESS - Record thread created");
+        }
+        else {
+            loggingSerial.println("FAILED - Record thread creation failed");
+        }
+        RECORD config = { RECORD_Config };
+        config.config = { RECORD_VERSION, UltraSonic_Filter_Size, UltraSonic_Outlier_Threshold, UltraSonic_Max_Age, Control_Frequency };
+        record(config);
+    #endif
+
     // start I2C 0 as master in fast mode
     if(i2c_master.begin(Pin_I2C_MASTER_SDA, Pin_I2C_MASTER_SCL, 400000)) {
         loggingSerial.println("SUCCESS - I2C master started");
@@ -164,36 +247,52 @@ void setup() {
     oled.clearDisplay();
     oled.display();
 
+    // from here on the bus task owns I2C 0, above the control task so commands go out right away
+    if(i2cBus.init(&i2c_master, 3, xPortGetCoreID())) {
+        loggingSerial.println("SUCCESS - I2C bus task started");
+    }
+    else {
+        loggingSerial.println("FAILED - I2C bus task start failed");
+    }
+
+    // display task shares the loop priority below the control task, it only sends changed parts of the frame
+    if(oledDisplay.init(&oled, &i2cBus, 0x3c, 10, 1, xPortGetCoreID())) {
+        loggingSerial.println("SUCCESS - OLED display task started");
+    }
+    else {
+        loggingSerial.println("FAILED - OLED display task start failed");
+    }
+
     // set pin modes of start button
-    pinMode(Pin_Start_Button, INPUT);
-    pinMode(Pin_Start_Button_LED, OUTPUT);
-    digitalWrite(Pin_Start_Button_LED, LOW);
+    halPinMode(Pin_Start_Button, HAL_Input);
+    halPinMode(Pin_Start_Button_LED, HAL_Output);
+    halDigitalWrite(Pin_Start_Button_LED, false);
 
     // set pin modes for ultrasonic sensors
     for(uint8_t i = 0; i < 6; i++) {
-        pinMode(Pins_UltraSonic_Echo[i], INPUT);
-        pinMode(Pins_UltraSonic_Trig[i], OUTPUT);
-        digitalWrite(Pins_UltraSonic_Trig[i], LOW);
+        halPinMode(Pins_UltraSonic_Echo[i], HAL_Input);
+        halPinMode(Pins_UltraSonic_Trig[i], HAL_Output);
+        halDigitalWrite(Pins_UltraSonic_Trig[i], false);
     }
 
     // set pin modes for course mode switches
-    pinMode(Pin_Obstacle_Switch, INPUT);
-    pinMode(Pin_Test_Mode_Switch, INPUT);
+    halPinMode(Pin_Obstacle_Switch, HAL_Input);
+    halPinMode(Pin_Test_Mode_Switch, HAL_Input);
     loggingSerial.println("SUCCESS - pin modes set");
 
     // wait for WRO Camera to get ready
-    delay(3000);
+    halDelay(3000);
 
     // start I2C 1 as slave in fast mode
-    if(i2c_slave.begin(0x51, Pin_I2C_SLAVE_SDA, Pin_I2C_SLAVE_SCL, 400000)) {
+    if(i2c_slave.beginSlave(0x51, Pin_I2C_SLAVE_SDA, Pin_I2C_SLAVE_SCL, 400000, i2cOnReceiveFunction)) {
         loggingSerial.println("SUCCESS - I2C slave started");
     }
     else {
         loggingSerial.println("FAILED - I2C slave start failed");
     }
-    i2c_slave.onReceive(i2cOnReceiveFunction);
     
     // start ultrasonic sensor thread
+    ultrasonic.init(UltraSonic_Filter_Size, UltraSonic_Outlier_Threshold, UltraSonic_Max_Age);
     if(xTaskCreatePinnedToCore(ultrasonicThreadFunction, "Ultrasonic Thread", 10000, NULL, 0, &ultrasonicThread, 1 - xPortGetCoreID()) == pdPASS) {
         loggingSerial.println("SUCCESS - Ultrasonic sensor thread created\n");
     }
@@ -202,31 +301,49 @@ void setup() {
     }
     
     // enable upper LED row, disable other lights
-    if(digitalRead(Pin_Test_Mode_Switch) == HIGH) {
+    if(halDigitalRead(Pin_Test_Mode_Switch)) {
         setLight(0, 0);
         setLight(1, 0);
         setLight(2, 1);
+        sendServoRegisters();
     }
 
-    digitalWrite(Pin_Start_Button_LED, HIGH);
-    loggingSerial.print(digitalRead(Pin_Test_Mode_Switch) ? (digitalRead(Pin_Obstacle_Switch) ? "Starter course" : "Obstacle course") : "Test mode");
+    halDigitalWrite(Pin_Start_Button_LED, true);
+    loggingSerial.print(halDigitalRead(Pin_Test_Mode_Switch) ? (halDigitalRead(Pin_Obstacle_Switch) ? "Starter course" : "Obstacle course") : "Test mode");
     loggingSerial.println(" - Waiting for start signal ...");
 
     // wait for start signal
-    while(digitalRead(Pin_Start_Button) == HIGH) {
-        if(millis() > lastDisplayUpdate + 1000) {
-            updateOLED(digitalRead(Pin_Test_Mode_Switch) ? (digitalRead(Pin_Obstacle_Switch) ? "Starter course" : "Obstacle course") : "Test mode");
-            lastDisplayUpdate = millis();
+    while(halDigitalRead(Pin_Start_Button)) {
+        if(halMillis() > lastDisplayUpdate + 1000) {
+            updateVoltageAndRPM();
+            updateOLED(halDigitalRead(Pin_Test_Mode_Switch) ? (halDigitalRead(Pin_Obstacle_Switch) ? "Starter course" : "Obstacle course") : "Test mode");
+            lastDisplayUpdate = halMillis();
         }
     }
 
     // start driving or start test mode
     loggingSerial.println("Start signal received");
-    digitalWrite(Pin_Start_Button_LED, LOW);
-    if(digitalRead(Pin_Test_Mode_Switch) == HIGH) {
-        setServo(0, 7);
-        antiRotation = rotation;
-        startPosDistance = ultrasonicDistance[US_CenterFront];
+    halDigitalWrite(Pin_Start_Button_LED, false);
+    if(halDigitalRead(Pin_Test_Mode_Switch)) {
+        SENSOR_SNAPSHOT sensors = getSensorSnapshot();
+        driveControl.init(halDigitalRead(Pin_Obstacle_Switch) ? StarterCourse : ObstacleCourse, maxSpeed, sensors);
+        setServo(0, driveControl.commands.motor * DRIVE_STEERING_STEP);
+        sendServoRegisters();
+        #ifdef RECORDING
+            RECORD start = { RECORD_Start };
+            recordTick(sensors, &start.start.tick);
+            start.start.course = driveControl.course;
+            start.start.maxSpeed = driveControl.maxSpeed;
+            record(start);
+        #endif
+
+        // start drive control task on this core, above the loop priority
+        if(controlTask.init(controlLoop, Control_Frequency, 2, xPortGetCoreID())) {
+            loggingSerial.println("SUCCESS - Control task started");
+        }
+        else {
+            loggingSerial.println("FAILED - Control task start failed");
+        }
     }
     else {
         loggingSerial.println("Test mode initialised\n");
@@ -240,17 +357,42 @@ void setup() {
 #pragma region loop
 
 void loop() {
-    if(digitalRead(Pin_Test_Mode_Switch) == HIGH) {
-        if(digitalRead(Pin_Obstacle_Switch)) {
-            driveControlStarterCourse();
-        }
-        else{
-            driveControlObstacleCourse();
-        }
-    }
-    if(millis() > lastDisplayUpdate + 1000) {
-        updateOLED(cameraSensorData.object.available ? ((cameraSensorData.object.color ? "Red" : "Green") + String(cameraSensorData.object.direction ? " - Right " : " - Left ") + String(cameraSensorData.object.angle)) : "No object");
-        lastDisplayUpdate = millis();
+    readSerialCommands();
+    if(halMillis() > lastDisplayUpdate + 100) {
+        char text[OLED_DISPLAY_TEXT_SIZE] = "No object";
+        CAMERA_SENSOR_DATA camera;
+        cameraSensorData.read(&camera);
+        if(camera.object.available) {
+            snprintf(text, sizeof(text), "%s - %s %u", camera.object.color ? "Red" : "Green", camera.object.direction ? "Right" : "Left", camera.object.angle);
+        }
+        updateOLED(text);
+        lastDisplayUpdate = halMillis();
+    }
+    if(halMillis() > lastDebugOutput + 1000) {
+        lastDebugOutput = halMillis();
+
+        #ifdef DEBUG_I2C_BUS
+            for(uint8_t i = 0; i < I2C_Priorities; i++) {
+                I2C_BUS_STATS stats = i2cBus.getStats(i);
+                loggingSerial.printf("I2C %u: %u transactions, %u failed, %u dropped, latency %u/%u us\n", i, stats.transactions, stats.failures, stats.dropped, stats.transactions ? (uint32_t)(stats.totalLatency / stats.transactions) : 0, stats.maxLatency);
+            }
+        #endif
+
+        #ifdef DEBUG_CAMERA_LINK
+            CAMERA_LINK_STATS linkStats = cameraLink.stats;
+            CAMERA_SENSOR_DATA camera;
+            cameraSensorData.read(&camera);
+            loggingSerial.printf("Camera link: %u received, %u dropped, %u corrupted, %u unknown\n", linkStats.received, linkStats.dropped, linkStats.corrupted, linkStats.unknown);
+            loggingSerial.printf("Camera: uptime %u ms, frame %u ms, %u send failures, errors 0x%02x\n", camera.health.uptime, camera.health.frameTime, camera.health.sendFailures, camera.health.errors);
+        #endif
+
+        #ifdef DEBUG_CONTROL_TIMING
+            CONTROL_TASK_STATS stats = controlTask.getStats();
+            loggingSerial.printf("Control: %u iterations, %u deadline misses, %u skipped, exec %u/%u us, jitter %u us\n", stats.iterations, stats.deadlineMisses, stats.skippedPeriods, stats.lastExecutionTime, stats.maxExecutionTime, stats.maxJitter);
+            for(uint8_t i = 0; i < CONTROL_TASK_HISTOGRAM_SIZE; i++) {
+                loggingSerial.printf("%u%s", stats.histogram[i], (i < CONTROL_TASK_HISTOGRAM_SIZE - 1) ? " " : "\n");
+            }
+        #endif
     }
 }
 
@@ -259,364 +401,290 @@ void loop() {
 
 #pragma region functions
 
-void driveControlStarterCourse() {
-    if((driveState.state != Curve) && (driveState.state != CurveEnding) && (outsideBorder != Unknown) && (ultrasonicDistance[US_LeftBack] + ultrasonicDistance[US_RightBack] < 1000) && (ultrasonicDistance[US_LeftFront] + ultrasonicDistance[US_RightFront] < 1000)) {
-        if(outsideBorder == Right) {
-            if(ultrasonicDistance[US_RightBack] == ultrasonicDistance[US_RightFront]) {
-                antiRotation = cameraSensorData.rotation;
-            }
-        }
-        if(outsideBorder == Left) {
-            if(ultrasonicDistance[US_LeftBack] == ultrasonicDistance[US_LeftFront]) {
-                antiRotation = cameraSensorData.rotation;
-            }
-        }
+// the controllers are only changed between two updates of the control task
+void applyTuning() {
+    portENTER_CRITICAL(&tuningMux);
+    TUNING changes = tuning;
+    tuning.changed = 0;
+    portEXIT_CRITICAL(&tuningMux);
+    if(changes.changed & Tuning_Heading) {
+        driveControl.steering.headingPid.gains = changes.heading;
     }
-    if(outsideBorder == Unknown) {
-        if(ultrasonicDistance[US_LeftFront] > 1100) {
-            outsideBorder = Right;
-            outsideBorder2 = Right;
-        }
-        if(ultrasonicDistance[US_RightFront] > 1100) {
-            outsideBorder = Left;
-            outsideBorder2 = Left;
-        }
+    if(changes.changed & Tuning_Offset) {
+        driveControl.steering.offsetPid.gains = changes.offset;
     }
-    if(outsideBorder != Unknown) {
-        if((driveState.state != Curve) && (driveState.state != CurveEnding)) {
-            if(curveCount < 12) {
-                // detect curves
-                if((millis() > lastCurve + 4000) && (outsideBorder == Right) && (ultrasonicDistance[US_LeftFront] > 1100)) {
-                    setServo(0, maxSpeed - 1);
-                    driveState.direction = Left;
-                    driveState.state = Curve;
-                    antiRotation = cameraSensorData.rotation;
-                    targetRotation = -1000;
-                    rotation = 0;
-                    setServo(1, -15);
-                    curveCount++;
-                    lastCurve = millis();
-                }
-                if((millis() > lastCurve + 4000) && (outsideBorder == Left) && (ultrasonicDistance[US_RightFront] > 1100)) {
-                    setServo(0, maxSpeed - 1);
-                    driveState.direction = Right;
-                    driveState.state = Curve;
-                    antiRotation = cameraSensorData.rotation;
-                    targetRotation = 1000;
-                    rotation = 0;
-                    setServo(1, 15);
-                    curveCount++;
-                    lastCurve = millis();
-                    
-                }
-                if(curveCount == 12) {
-                    outsideBorder = End;
-                }
-            }
-            else {
-                // find end position
-                if((ultrasonicDistance[US_CenterFront] != 0) && (ultrasonicDistance[US_CenterFront] < startPosDistance + 50)) {
-                    setServo(0, 0);
-                }
-            }
-        }
-        if((((driveState.state == Curve) && (((driveState.direction == Left) && (rotation <= targetRotation)) || ((driveState.direction == Right) && (rotation >= targetRotation)))) || ((driveState.state == Curve) && (driveState.direction == Right) && (rotation > 800) && ((outsideBorder2 == Right) && (ultrasonicDistance[US_RightBack] - ultrasonicDistance[US_RightFront] < 10)))) || ((driveState.state == Curve) && (driveState.direction == Right) && (rotation > 800) && ((outsideBorder2 == Left) && (ultrasonicDistance[US_LeftBack] - ultrasonicDistance[US_LeftFront] < 10)))) {
-            setServo(1, 0);
-            delay(50);
-            setServo(0, 8);
-            driveState.state = CurveEnding;
-            lastCurve = millis();
-        }
-        // reset curve status
-        if((driveState.state == CurveEnding) && (((driveState.direction == Left) && (ultrasonicDistance[US_LeftBack] < 1200)) || ((driveState.direction == Right) && (ultrasonicDistance[US_RightBack] < 1200)))) {
-            driveState.direction = Unknown;
-            driveState.state = Unknown;
-        }
+    if(changes.changed & Tuning_Speed) {
+        driveControl.speedControl.pid.gains = changes.speed;
     }
-    if(((driveState.state == Unknown) || (driveState.state == UltrasonicCorrection) || (driveState.state == BorderCorrection) || (driveState.state == CurveEnding)) && (driveState.state != Curve)) {
-        // direction correction (ultrasonic)
-        if(driveState.state != BorderCorrection) {
-            if(((ultrasonicDistance[US_LeftFront] - ultrasonicDistance[US_LeftBack] > 40) && (outsideBorder2 == Left)) || ((ultrasonicDistance[US_RightFront] - ultrasonicDistance[US_RightBack] < -40) && (outsideBorder2 == Right))) {
-                driveState.direction = Left;
-                driveState.state = UltrasonicCorrection;
-                setServo(1, -5);
-            }
-            else if(((ultrasonicDistance[US_LeftFront] - ultrasonicDistance[US_LeftBack] > 20) && (outsideBorder2 == Left)) || ((ultrasonicDistance[US_RightFront] - ultrasonicDistance[US_RightBack] < -20) && (outsideBorder2 == Right))) {
-                driveState.direction = Left;
-                driveState.state = UltrasonicCorrection;
-                setServo(1, -3);
-            }
-            else if((driveState.state == UltrasonicCorrection) && (driveState.direction == Left) && (ultrasonicDistance[US_LeftFront] - ultrasonicDistance[US_LeftBack] < 20) && (ultrasonicDistance[US_RightFront] - ultrasonicDistance[US_RightBack] > -20)) {
-                driveState.direction = Unknown;
-                driveState.state = Unknown;
-                setServo(1, 0);
-            }
-            else if(((ultrasonicDistance[US_LeftFront] - ultrasonicDistance[US_LeftBack] < -60) && (outsideBorder2 == Left)) || ((ultrasonicDistance[US_RightFront] - ultrasonicDistance[US_RightBack] > 60) && (outsideBorder2 == Right))) {
-                driveState.direction = Right;
-                driveState.state = UltrasonicCorrection;
-                setServo(1, 5);
-            }
-            else if(((ultrasonicDistance[US_LeftFront] - ultrasonicDistance[US_LeftBack] < -20) && (outsideBorder2 == Left)) || ((ultrasonicDistance[US_RightFront] - ultrasonicDistance[US_RightBack] > 20) && (outsideBorder2 == Right))) {
-                driveState.direction = Right;
-                driveState.state = UltrasonicCorrection;
-                setServo(1, 3);
-            }
-            else if((driveState.state == UltrasonicCorrection) && (driveState.direction == Right) && (ultrasonicDistance[US_LeftFront] - ultrasonicDistance[US_LeftBack] > -20) && (ultrasonicDistance[US_RightFront] - ultrasonicDistance[US_RightBack] < 20)) {
-                driveState.direction = Unknown;
-                driveState.state = Unknown;
-                setServo(1, 0);
-            }
-        }
-        // near border correction (ultrasonic)
-        if((driveState.state == BorderCorrection) && (ultrasonicDistance[US_LeftFront] > 150) && (ultrasonicDistance[US_RightFront] > 150)) {
-            driveState.direction = Unknown;
-            driveState.state = Unknown;
-            setServo(1, 0);
-        }
-        if((ultrasonicDistance[US_LeftFront] < 80) && (ultrasonicDistance[US_LeftFront] != 0)) {
-            driveState.direction = Right;
-            driveState.state = BorderCorrection;
-            setServo(1, 10);
-        }
-        else if((ultrasonicDistance[US_LeftFront] < 120) && (ultrasonicDistance[US_LeftFront] != 0)) {
-            driveState.direction = Right;
-            driveState.state = BorderCorrection;
-            setServo(1, 7);
-        }
-        else if((ultrasonicDistance[US_RightFront] < 80) && (ultrasonicDistance[US_RightFront] != 0)) {
-            driveState.direction = Left;
-            driveState.state = BorderCorrection;
-            setServo(1, -10);
-        }
-        else if((ultrasonicDistance[US_RightFront] < 120) && (ultrasonicDistance[US_RightFront] != 0)) {
-            driveState.direction = Left;
-            driveState.state = BorderCorrection;
-            setServo(1, -7);
-        }
-        if((outsideBorder != End) && (driveState.state != Curve) && (ultrasonicDistance[US_CenterFront] < 800)) {
-            setServo(0, 7);
-        }
-        if((outsideBorder != End) && (driveState.state != Curve) && (ultrasonicDistance[US_CenterFront] < 1200)) {
-            setServo(0, maxSpeed - 2);
-        }
-        else if(((driveState.state == BorderCorrection) || (driveState.state == UltrasonicCorrection)) && (outsideBorder != End)) {
-            setServo(0, maxSpeed - 3);
-        }
-        else if((driveState.state != Curve) && (outsideBorder != End)) {
-            setServo(0, maxSpeed - 1);
-        }
+    if(changes.changed & Tuning_TargetOffset) {
+        driveControl.steering.targetOffset = changes.targetOffset;
     }
 }
 
-void driveControlObstacleCourse() {
-    if((ultrasonicDistance[US_CenterFront] < 1000) && (driveState.state != Curve)) {
-        setServo(0, 6);
+void controlLoop() {
+    // the odometry needs the encoder at a steady rate, the power board is polled from here while driving
+    static uint8_t powerPollTick = 0;
+    if(++powerPollTick >= Power_Poll_Divider) {
+        powerPollTick = 0;
+        requestPowerSensorData(SERVO_Reg_Analog, sizeof(SERVO_READ_REGISTERS));
     }
-    else if(driveState.state != Curve) {
-        setServo(0,8);
+    else {
+        requestPowerSensorData(SERVO_Reg_Motor_Turns, SERVO_Reg_Read_End - SERVO_Reg_Motor_Turns);
+    }
+    applyTuning();
+    DRIVE_STATE lastDriveState = driveControl.driveState;
+    uint8_t lastCurveCount = driveControl.curveCount;
+    SENSOR_SNAPSHOT sensors = getSensorSnapshot();
+    driveControl.update(sensors);
+    if((driveControl.driveState.direction != lastDriveState.direction) || (driveControl.driveState.state != lastDriveState.state)) {
+        trace.log(TRACE_DriveState, driveControl.driveState.direction, driveControl.driveState.state);
+    }
+    if(driveControl.curveCount != lastCurveCount) {
+        trace.log(TRACE_Curve, driveControl.curveCount, driveControl.driveState.direction);
+    }
+    setServo(0, driveControl.commands.motor * DRIVE_STEERING_STEP);
+    setServo(1, driveControl.commands.steeringAngle);
+    sendServoRegisters();
+
+    #ifdef TELEMETRY
+        sendTelemetry(sensors);
+    #endif
+    #ifdef RECORDING
+        RECORD tick = { RECORD_Tick };
+        recordTick(sensors, &tick.tick);
+        record(tick);
+    #endif
+}
+
+// a sample that does not fit into the TX buffer is dropped, the control task never waits for the UART
+// and the capture tool counts the sequence gap
+void sendTelemetry(const SENSOR_SNAPSHOT& sensors) {
+    static uint16_t sequence = 0;
+    static uint8_t frame[TELEMETRY_MAX_FRAME];
+    TELEMETRY_SAMPLE sample = {};
+    sample.version = TELEMETRY_VERSION;
+    sample.sequence = sequence++;
+    sample.time = sensors.time;
+    sample.distance0 = sensors.distance[0];
+    sample.distance1 = sensors.distance[1];
+    sample.distance2 = sensors.distance[2];
+    sample.distance3 = sensors.distance[3];
+    sample.distance4 = sensors.distance[4];
+    sample.distance5 = sensors.distance[5];
+    sample.rotation = sensors.rotation;
+    sample.object = sensors.object.available | (sensors.object.color << 1) | (sensors.object.direction << 2) | (sensors.object.angle << 3);
+    sample.speed = driveControl.commands.speed;
+    sample.steering = driveControl.commands.steering;
+    sample.motor = driveControl.commands.motor;
+    sample.velocity = driveControl.commands.velocity;
+    sample.measured = (int16_t)driveControl.speedControl.speed;
+    sample.direction = driveControl.driveState.direction;
+    sample.state = driveControl.driveState.state;
+    sample.curveCount = driveControl.curveCount;
+    sample.motorTurns = sensors.motorTurns;
+    sample.battery = sensors.battery;
+    sample.x = (int16_t)driveControl.odometry.x;
+    sample.y = (int16_t)driveControl.odometry.y;
+    sample.heading = (int16_t)lroundf(fmodf(driveControl.odometry.theta * (1800 / M_PI), 3600));
+
+    size_t length = telemetryEncode(sample, frame);
+    if(loggingSerial.availableForWrite() >= (int)length) {
+        loggingSerial.write(frame, length);
     }
-    if(outsideBorder == Unknown) {
-        if(ultrasonicDistance[US_LeftFront] > 1100) {
-            outsideBorder = Right;
-        }
-        if(ultrasonicDistance[US_RightFront] > 1100) {
-            outsideBorder = Left;
-        }
+}
+
+void fireUltrasonic(uint8_t num) {
+    halDigitalWrite(Pins_UltraSonic_Trig[num], true);
+    halDelay(1);
+    halDigitalWrite(Pins_UltraSonic_Trig[num], false);
+    uint32_t echoTime = halPulseIn(Pins_UltraSonic_Echo[num], true);
+    int32_t distance = (int32_t)((echoTime * 0.1716) - (((num == US_LeftBack) || (num == US_RightBack)) * 17.5));
+    uint32_t time = halMillis();
+    portENTER_CRITICAL(&ultrasonicMux);
+    ultrasonic.add(num, (uint16_t)((distance > 0) ? distance : 0), time, echoTime != 0);
+    portEXIT_CRITICAL(&ultrasonicMux);
+    #ifdef RECORDING
+        RECORD sample = { RECORD_Ultrasonic };
+        sample.ultrasonic = { time, num, (uint16_t)((distance > 0) ? distance : 0), echoTime != 0 };
+        record(sample);
+    #endif
+}
+
+uint32_t traceClock() {
+    return (uint32_t)esp_timer_get_time();
+}
+
+// binary frames for the trace decoder of WRO Tools
+void traceDump() {
+    TRACE_RECORD record;
+    uint8_t frame[TRACE_FRAME_SIZE];
+    while(trace.read(&record)) {
+        TRACE::frame(record, frame);
+        loggingSerial.write(frame, TRACE_FRAME_SIZE);
     }
-    if(outsideBorder != Unknown) {
-        if((driveState.state != Curve) && (driveState.state != CurveEnding) && (driveState.state != BorderCorrection)) {
-            if(curveCount < 12) {
-                if((millis() > lastCurve + 6000) && (outsideBorder == Right) && (ultrasonicDistance[US_LeftFront] > 1300)) {
-                    if((cameraSensorData.object.available == 1) && (cameraSensorData.object.color == 1)) {
-                        if((cameraSensorData.object.available == 1) && (cameraSensorData.object.color == 1)) {
-                            setServo(0, maxSpeed - 1);
-                            delay(1500);
-                        }
-                    }
-                    else {
-                        delay(500);
-                        if((cameraSensorData.object.available == 1) && (cameraSensorData.object.color == 1)) {
-                            setServo(0, maxSpeed - 1);
-                            delay(1000);
-                        }
-                    }
-                    driveState.direction = Left;
-                    driveState.state = Curve;
-                    antiRotation = cameraSensorData.rotation;
-                    targetRotation = -1000;
-                    rotation = 0;
-                    setServo(1, -15);
-                    setServo(0, maxSpeed - 1);
-                    curveCount++;
-                }
-                if((millis() > lastCurve + 8000) && (outsideBorder == Left) && (ultrasonicDistance[US_RightFront] > 1300)) {
-                    if((cameraSensorData.object.available == 1) && (cameraSensorData.object.color == 0)) {
-                        if((cameraSensorData.object.available == 1) && (cameraSensorData.object.color == 0)) {
-                            setServo(0, maxSpeed - 1);
-                            delay(1500);
-                        }
-                    }
-                    else {
-                        delay(500);
-                        if((cameraSensorData.object.available == 1) && (cameraSensorData.object.color == 0)) {
-                            setServo(0, maxSpeed - 1);
-                            delay(1000);
-                        }
-                    }
-                    driveState.direction = Right;
-                    driveState.state = Curve;
-                    antiRotation = cameraSensorData.rotation;
-                    targetRotation = 1000;
-                    rotation = 0;
-                    setServo(1, 15);
-                    setServo(0, maxSpeed - 1);
-                    curveCount++;
-                }
-                if(curveCount == 12) {
-                    outsideBorder = End;
-                }
-            }
-            else {
-                if((ultrasonicDistance[US_CenterFront] != 0) && (ultrasonicDistance[US_CenterFront] < startPosDistance + 50)) {
-                    setServo(0, 0);
-                }
-            }
-        }
-        if((((driveState.state == Curve) && (((driveState.direction == Left) && (rotation <= targetRotation)) || ((driveState.direction == Right) && (rotation >= targetRotation)))) || ((driveState.state == Curve) && (driveState.direction == Right) && (rotation > 800) && ((outsideBorder2 == Right) && (ultrasonicDistance[US_RightBack] - ultrasonicDistance[US_RightFront] < 10)))) || ((driveState.state == Curve) && (driveState.direction == Right) && (rotation > 800) && ((outsideBorder2 == Left) && (ultrasonicDistance[US_LeftBack] - ultrasonicDistance[US_LeftFront] < 10)))) {
-            setServo(1, 0);
-            delay(50);
-            setServo(0, 8);
-            driveState.state = CurveEnding;
-            lastCurve = millis();
-        }
-        if((driveState.state == CurveEnding) && (((driveState.direction == Left) && (ultrasonicDistance[US_LeftBack] < 1200)) || ((driveState.direction == Right) && (ultrasonicDistance[US_RightBack] < 1200)))) {
-            driveState.direction = Unknown;
-            driveState.state = Unknown;
-        }
+}
+
+void traceThreadFunction(void* parameter) {
+    while(true) {
+        traceDump();
+        halDelay(10);
     }
-    if(((driveState.state == Unknown) || (driveState.state == UltrasonicCorrection) || (driveState.state == BorderCorrection) || (driveState.state == CurveEnding)) && (driveState.state != Curve)) {
-        if(driveState.state != BorderCorrection) {
-            if(((ultrasonicDistance[US_LeftFront] - ultrasonicDistance[US_LeftBack] > 40) && (outsideBorder == Left)) || ((ultrasonicDistance[US_RightFront] - ultrasonicDistance[US_RightBack] < -40) && (outsideBorder == Right))) {
-                driveState.direction = Left;
-                driveState.state = UltrasonicCorrection;
-                setServo(1, -3);
-            }
-            else if((driveState.state == UltrasonicCorrection) && (driveState.direction == Left) && (ultrasonicDistance[US_LeftFront] - ultrasonicDistance[US_LeftBack] < 20) && (ultrasonicDistance[US_RightFront] - ultrasonicDistance[US_RightBack] > -20)) {
-                driveState.direction = Unknown;
-                driveState.state = Unknown;
-                setServo(1, 0);
-            }
-            else if(((ultrasonicDistance[US_LeftFront] - ultrasonicDistance[US_LeftBack] < -40) && (outsideBorder == Left)) || ((ultrasonicDistance[US_RightFront] - ultrasonicDistance[US_RightBack] > 40) && (outsideBorder == Right))) {
-                driveState.direction = Right;
-                driveState.state = UltrasonicCorrection;
-                setServo(1, 3);
-            }
-            else if((driveState.state == UltrasonicCorrection) && (driveState.direction == Right) && (ultrasonicDistance[US_LeftFront] - ultrasonicDistance[US_LeftBack] > -20) && (ultrasonicDistance[US_RightFront] - ultrasonicDistance[US_RightBack] < 20)) {
-                driveState.direction = Unknown;
-                driveState.state = Unknown;
-                setServo(1, 0);
-            }
-        }
-        if(outsideBorder != Unknown) {
-            if((cameraSensorData.object.color == 0) && (cameraSensorData.object.available == 1) && (ultrasonicDistance[US_LeftFront] < 100)){
-                driveState.direction = Right;
-                driveState.state = BorderCorrection;
-                setServo(1, 8);
-            }
-            else if ((cameraSensorData.object.color == 0) && (cameraSensorData.object.available == 1) && (ultrasonicDistance[US_LeftFront] > 170) && (((outsideBorder == Left) && (ultrasonicDistance[US_LeftBack] - ultrasonicDistance[US_LeftFront] < 20)) || (((outsideBorder == Right) && (ultrasonicDistance[US_RightBack] - ultrasonicDistance[US_RightFront]> -20))))) { // 0 = Grün
-                driveState.direction = Left;
-                driveState.state = BorderCorrection;
-                setServo(1, -8);
-            }
-            else if((cameraSensorData.object.color == 0) && (cameraSensorData.object.available == 1)) {
-                driveState.direction = Unknown;
-                driveState.state = Unknown;
-                setServo(1, 0);
-            }          
-            if((cameraSensorData.object.color == 1) && (cameraSensorData.object.available == 1) && (ultrasonicDistance[US_RightFront] < 100)) {
-                driveState.direction = Left;
-                driveState.state = BorderCorrection;
-                setServo(1, -10);
-            }
-            else if (((cameraSensorData.object.direction == 1) && (cameraSensorData.object.color == 1) && (cameraSensorData.object.available == 1) && (ultrasonicDistance[US_RightFront] > 150) && (((outsideBorder == Left) && (ultrasonicDistance[US_LeftFront] - ultrasonicDistance[US_LeftBack] < 25)) || (((outsideBorder == Right) && (ultrasonicDistance[US_RightBack] - ultrasonicDistance[US_RightFront] < 25))))) && (ultrasonicDistance[US_CenterFront] > 200)) { // 1 = Rot
-                driveState.direction = Right;
-                driveState.state = BorderCorrection;
-                setServo(1, 12);
-            }
-            else if (((cameraSensorData.object.color == 1) && (cameraSensorData.object.available == 1) && (ultrasonicDistance[US_RightFront] > 150) && (((outsideBorder == Left) && (ultrasonicDistance[US_LeftFront] - ultrasonicDistance[US_LeftBack] < 22)) || (((outsideBorder == Right) && (ultrasonicDistance[US_RightBack] - ultrasonicDistance[US_RightFront] < 22))))) && (ultrasonicDistance[US_CenterFront] > 200)) { // 1 = Rot
-                driveState.direction = Right;
-                driveState.state = BorderCorrection;
-                setServo(1, 12);
-            }
-            else if((cameraSensorData.object.color == 1) && (cameraSensorData.object.available == 1)) {
-                driveState.direction = Unknown;
-                driveState.state = Unknown;
-                setServo(1, 0);
-            }
-            if(cameraSensorData.object.available == 0) {
-                if((driveState.state == BorderCorrection) && (ultrasonicDistance[US_LeftFront] > 300) && (ultrasonicDistance[US_RightFront] > 300)) {
-                    driveState.direction = Unknown;
-                    driveState.state = Unknown;
-                    setServo(1, 0);
-                }
-                if((ultrasonicDistance[US_LeftFront] < 300) && (ultrasonicDistance[US_LeftFront] != 0)) {
-                    driveState.direction = Right;
-                    driveState.state = BorderCorrection;
-                    setServo(1, 10);
-                }
-                else if((ultrasonicDistance[US_RightFront] < 300) && (ultrasonicDistance[US_RightFront] != 0)) {
-                    driveState.direction = Left;
-                    driveState.state = BorderCorrection;
-                    setServo(1, -10);
-                }
-            }
+}
+
+void ultrasonicThreadFunction(void* parameter) {
+    while(true) {
+        for(uint8_t i = 0; i < 6; i++) {
+            fireUltrasonic((UltraSonic_Process[i] == Variable) ? ((driveControl.outsideBorder == Left) ? US_RightFront : ((driveControl.outsideBorder == Right) ? US_LeftFront : US_CenterFront)) : UltraSonic_Process[i]);
+            halDelay(30);
         }
     }
 }
 
-void fireUltrasonic(uint8_t num) {
-    digitalWrite(Pins_UltraSonic_Trig[num], HIGH);
-    delay(1);
-    digitalWrite(Pins_UltraSonic_Trig[num], LOW);
-    ultrasonicDistance[num] = (uint16_t)((pulseIn(Pins_UltraSonic_Echo[num], HIGH) * 0.1716) - (((num == US_LeftBack) || (num == US_RightBack)) * 17.5));
+// one coherent copy of the camera data per tick, with the age of its messages
+SENSOR_SNAPSHOT getSensorSnapshot() {
+    CAMERA_SENSOR_DATA camera;
+    cameraSensorData.read(&camera);
+    RECORD_TICK tick = {};
+    tick.time = halMillis();
+    tick.rotation = camera.rotation;
+    tick.object = recordObject(camera.object);
+    tick.rotationAge = (tick.time - camera.rotationTime < 0xFFFF) ? (uint16_t)(tick.time - camera.rotationTime) : 0xFFFF;
+    tick.objectAge = (tick.time - camera.objectTime < 0xFFFF) ? (uint16_t)(tick.time - camera.objectTime) : 0xFFFF;
+    tick.motorTurns = powerSensorData.motorTurns[0];
+    tick.motorRpm = powerSensorData.motorRpm[0];
+    tick.battery = (uint16_t)(powerSensorData.analogValues[0] * VOLTAGE_PER_ADC_STEP * 1000);
+    SENSOR_SNAPSHOT sensors;
+    portENTER_CRITICAL(&ultrasonicMux);
+    recordSnapshot(tick, ultrasonic, &sensors);
+    portEXIT_CRITICAL(&ultrasonicMux);
+    return sensors;
 }
 
-void ultrasonicThreadFunction(void* parameter) {
+// the record order is the order of the calls, the queue never blocks the caller
+void record(const RECORD& record) {
+    if(xQueueSend(recordQueue, &record, 0) != pdTRUE) {
+        recordDropped++;
+    }
+}
+
+void recordThreadFunction(void* parameter) {
+    RECORD record;
+    uint8_t frame[RECORD_MAX_FRAME];
     while(true) {
-        for(uint8_t i = 0; i < 6; i++) {
-            fireUltrasonic((UltraSonic_Process[i] == Variable) ? ((outsideBorder == Left) ? US_RightFront : ((outsideBorder == Right) ? US_LeftFront : US_CenterFront)) : UltraSonic_Process[i]);
-            delay(30);
+        if(xQueueReceive(recordQueue, &record, portMAX_DELAY) == pdTRUE) {
+            loggingSerial.write(frame, recordEncode(record, frame));
         }
     }
 }
 
-void setServo(uint8_t index, int8_t speed) {
-    if(servoState[index] != speed) {
-        servoState[index] = speed;
-        i2c_master.beginTransmission(0x50);
-        i2c_master.write(((index & 0x3) << 5) | ((speed < 0) * 0x10) | (((speed < 0) ? (-speed) : speed)) & 0xf);
-        i2c_master.endTransmission();
+void recordTick(const SENSOR_SNAPSHOT& sensors, RECORD_TICK* tick) {
+    *tick = { sensors.time, sensors.rotation, recordObject(sensors.object), sensors.rotationAge, sensors.objectAge, sensors.motorTurns, sensors.motorRpm, sensors.battery, driveControl.commands.motor, driveControl.commands.steering, recordDropped };
+}
 
-        loggingSerial.print("Servo " + String(index, 10) + ": ");
-        loggingSerial.println(speed, 10);
+// one write of all targets and lights, a rejected or failed write is repeated with the next tick
+void sendServoRegisters() {
+    if(servoRegisterStatus == I2C_Failed) {
+        servoRegisterStatus = I2C_Idle;
+        servoRegistersChanged = true;
     }
+    if(!servoRegistersChanged) return;
+    uint8_t data[1 + sizeof(SERVO_WRITE_REGISTERS)] = { SERVO_Reg_Targets };
+    memcpy(data + 1, &servoRegisters, sizeof(SERVO_WRITE_REGISTERS));
+    servoRegistersChanged = !i2cBus.write(SERVO_BOARD_ADDRESS, data, sizeof(data), I2C_Actuator, &servoRegisterStatus);
 }
 
-void setLight(uint8_t index, bool state) {
-    if((lightState & (1 << index)) >> index != state) {
-        lightState ^= 1 << index;
-        i2c_master.beginTransmission(0x50);
-        i2c_master.write(0x80 | ((index & 0x3f) << 1) | state);
-        i2c_master.endTransmission();
+// angle in 1/10 degrees, sent by sendServoRegisters
+void setServo(uint8_t index, int16_t angle) {
+    if(servoRegisters.targets[index] != angle) {
+        servoRegisters.targets[index] = angle;
+        servoRegistersChanged = true;
+        trace.log(TRACE_Servo, index, angle);
+    }
+}
 
-        loggingSerial.print("LED " + String(index, 10) + ": ");
-        loggingSerial.println(state ? "ON" : "OFF");
+void setLight(uint8_t index, bool state) {
+    if(((servoRegisters.lights >> index) & 1) != state) {
+        servoRegisters.lights ^= 1 << index;
+        servoRegistersChanged = true;
+        trace.log(TRACE_Light, index, state);
     }
 }
 
-void i2cOnReceiveFunction(int bytes) {
-    i2c_slave.readBytes((uint8_t*)&cameraSensorData, sizeof(CAMERA_SENSOR_DATA));
-    rotation = cameraSensorData.rotation - antiRotation;
+// broken and unknown messages are only counted, the last valid values stay
+void i2cOnReceiveFunction(const uint8_t* data, size_t length) {
+    CAMERA_LINK_MESSAGE message;
+    if(!cameraLink.decode(data, length, &message)) return;
+    switch(message.type) {
+        case CAMERA_Heading:
+            cameraReceived.rotation = message.heading.rotation;
+            cameraReceived.rotationTime = halMillis();
+            break;
+        case CAMERA_Obstacles: {
+            uint8_t object = (message.obstacles.count > 0) ? message.obstacles.objects[0] : 0;
+            cameraReceived.object.available = object & 1;
+            cameraReceived.object.color = (object >> 1) & 1;
+            cameraReceived.object.direction = (object >> 2) & 1;
+            cameraReceived.object.angle = object >> 3;
+            cameraReceived.objectTime = halMillis();
+            break;
+        }
+        case CAMERA_Health:
+            cameraReceived.health = message.health;
+            break;
+    }
+    cameraSensorData.write(cameraReceived);
+}
+
+// tuning commands: "pid heading|offset|speed <kp> <ki> <kd>", "offset <mm>", "trace dump"
+void readSerialCommands() {
+    static char command[64];
+    static uint8_t length = 0;
+    while(loggingSerial.available()) {
+        char c = loggingSerial.read();
+        if((c != '\n') && (c != '\r')) {
+            if(length < sizeof(command) - 1) {
+                command[length++] = c;
+            }
+            continue;
+        }
+        command[length] = 0;
+        length = 0;
+
+        char name[16];
+        PID_GAINS gains;
+        uint16_t offset;
+        if(sscanf(command, "pid %15s %f %f %f", name, &gains.kp, &gains.ki, &gains.kd) == 4) {
+            portENTER_CRITICAL(&tuningMux);
+            if(strcmp(name, "heading") == 0) {
+                tuning.heading = gains;
+                tuning.changed |= Tuning_Heading;
+            }
+            else if(strcmp(name, "offset") == 0) {
+                tuning.offset = gains;
+                tuning.changed |= Tuning_Offset;
+            }
+            else if(strcmp(name, "speed") == 0) {
+                tuning.speed = gains;
+                tuning.changed |= Tuning_Speed;
+            }
+            else {
+                portEXIT_CRITICAL(&tuningMux);
+                continue;
+            }
+            portEXIT_CRITICAL(&tuningMux);
+            loggingSerial.printf("PID %s: kp %.4f ki %.4f kd %.4f\n", name, gains.kp, gains.ki, gains.kd);
+        }
+        else if(sscanf(command, "offset %hu", &offset) == 1) {
+            portENTER_CRITICAL(&tuningMux);
+            tuning.targetOffset = offset;
+            tuning.changed |= Tuning_TargetOffset;
+            portEXIT_CRITICAL(&tuningMux);
+            loggingSerial.printf("Target offset: %u mm\n", offset);
+        }
+        else if(strcmp(command, "trace dump") == 0) {
+            traceDump();
+        }
+    }
 }
 
 void testAlgorithm() {
@@ -624,8 +692,12 @@ void testAlgorithm() {
     // scan for I2C devices
     loggingSerial.println("Scanning for I2C devices:");
     for(uint8_t i = 1; i < 0x7f; i++) {
-        i2c_master.beginTransmission(i);
-        if(i2c_master.endTransmission() == 0) {
+        volatile uint8_t status = I2C_Idle;
+        i2cBus.write(i, NULL, 0, I2C_Sensor, &status);
+        while(status == I2C_Pending) {
+            halDelay(1);
+        }
+        if(status == I2C_Done) {
             loggingSerial.print("I2C device found on address ");
             loggingSerial.println(i, HEX);
         }
@@ -633,31 +705,39 @@ void testAlgorithm() {
 
     // print ultrasonic sensor data
     loggingSerial.println("\nTesting the ultrasonic sensors:");
+    SENSOR_SNAPSHOT sensors = getSensorSnapshot();
     for(uint8_t i = 0; i < 6; i++) {
-        loggingSerial.println("Ultrasonic sensor " + String((uint32_t)i) + ": " + String(ultrasonicDistance[i] / 10.0, 1) + " cm");
+        loggingSerial.println("Ultrasonic sensor " + String((uint32_t)i) + ": " + String(sensors.distance[i] / 10.0, 1) + " cm");
     }
 
     // test LED functionality
     loggingSerial.println("\nTesting lights:");
     setLight(0, 1);
-    delay(2000);
+    sendServoRegisters();
+    halDelay(2000);
     setLight(0, 0);
+    sendServoRegisters();
 
     setLight(1, 1);
-    delay(2000);
+    sendServoRegisters();
+    halDelay(2000);
     setLight(1, 0);
+    sendServoRegisters();
 
     setLight(2, 1);
-    delay(2000);
+    sendServoRegisters();
+    halDelay(2000);
     setLight(2, 0);
+    sendServoRegisters();
 
     // test servo functionality
     loggingSerial.println("\nTesting servos:");
     for(uint8_t i = 0; i < 2; i++) {
         for(uint8_t j = 0; j < 4; j++) {
             for(int8_t k = 0; k < 16; k++) {
-                setServo(i, j & 2 ? 0 - ( j & 1 ? 15 - k : k) : ( j & 1 ? 15 - k : k));
-                delay(500);
+                setServo(i, (j & 2 ? 0 - ( j & 1 ? 15 - k : k) : ( j & 1 ? 15 - k : k)) * DRIVE_STEERING_STEP);
+                sendServoRegisters();
+                halDelay(500);
             }
         }
     }
@@ -665,59 +745,71 @@ void testAlgorithm() {
     // print power pcb sensor data
     loggingSerial.println("\nTesting power pcb sensors:");
     updateVoltageAndRPM();
-    loggingSerial.println("Battery Voltage: " + String(powerSensorData.analogValues[0] * 0.012060546875, 2) + " V");
+    loggingSerial.println("Battery Voltage: " + String(powerSensorData.analogValues[0] * VOLTAGE_PER_ADC_STEP, 2) + " V");
     loggingSerial.println("Motor turns: " + String(powerSensorData.motorTurns[0] / 8.0, 3));
+    loggingSerial.println("Motor speed: " + String((int32_t)powerSensorData.motorRpm[0]) + " rpm");
 
     // print camera data
     loggingSerial.println("\nTesting camera sensors:");
-    loggingSerial.println("Rotation: " + String(rotation / 10.0, 1) + "°");
-    if(cameraSensorData.object.available) {
-        if(cameraSensorData.object.color) {
+    loggingSerial.printf("Link: %u received, %u dropped, %u corrupted, %u unknown\n", cameraLink.stats.received, cameraLink.stats.dropped, cameraLink.stats.corrupted, cameraLink.stats.unknown);
+    CAMERA_SENSOR_DATA camera;
+    cameraSensorData.read(&camera);
+    loggingSerial.printf("Frame time: %u ms, errors 0x%02x\n", camera.health.frameTime, camera.health.errors);
+    loggingSerial.println("Rotation: " + String(camera.rotation / 10.0, 1) + "°");
+    if(camera.object.available) {
+        if(camera.object.color) {
             loggingSerial.print("Red object found");
         }
         else {
             loggingSerial.print("Green object found");
         }
-        if(cameraSensorData.object.direction) {
+        if(camera.object.direction) {
             loggingSerial.print(" at Right ");
         }
         else {
             loggingSerial.print(" at Left ");
         }
-        loggingSerial.println(cameraSensorData.object.angle);
+        loggingSerial.println(camera.object.angle);
     }
     else {
         loggingSerial.println("No object found");
     }
 }
 
-void updateOLED(String secondLine) {
-    updateVoltageAndRPM();
-    float batteryVoltage = (powerSensorData.analogValues[0] * 0.012060546875);
+// only hands the state to the display task, rendering and transfer happen there
+void updateOLED(const char* secondLine) {
+    OLED_DISPLAY_STATE state = {};
+    float batteryVoltage = (powerSensorData.analogValues[0] * VOLTAGE_PER_ADC_STEP);
     float chargeLevel = (batteryVoltage - VOLTAGE_BATTERY_EMPTY) / (VOLTAGE_BATTERY_CHARGED - VOLTAGE_BATTERY_EMPTY);
-    oled.clearDisplay();
-    oled.setCursor(2, 2);
-    oled.setTextSize(1);
-    oled.setTextColor(1);
-    oled.print(batteryVoltage, 2);
-    oled.print(" V");
-    oled.drawRect(80, 2, 40, 8, 1);
-    oled.fillRect(120, 4, 3, 4, 1);
-    if(chargeLevel < 1) {
-        oled.fillRect(120, 5, 2, 2, 0);
-    }
-    oled.fillRect(80, 2, (uint8_t)(40 * (chargeLevel > 0 ? (chargeLevel < 1 ? chargeLevel : 1) : 0)), 8, 1);
-    oled.setCursor(2, 16);
-    oled.print(secondLine);
-    oled.display();
+    state.battery = (uint16_t)(batteryVoltage * 1000);
+    state.charge = (uint8_t)(100 * (chargeLevel > 0 ? (chargeLevel < 1 ? chargeLevel : 1) : 0));
+    strncpy(state.text, secondLine, sizeof(state.text) - 1);
+    oledDisplay.setState(state);
+}
+
+// non blocking, a finished read is taken over and the next one queued
+void requestPowerSensorData(uint8_t reg, uint8_t length) {
+    if(powerSensorStatus == I2C_Pending) return;
+    if(powerSensorStatus == I2C_Done) {
+        memcpy((uint8_t*)&powerSensorData + (powerSensorRegister - SERVO_Reg_Analog), powerSensorBuffer, powerSensorLength);
+    }
+    powerSensorRegister = reg;
+    powerSensorLength = length;
+    i2cBus.readRegisters(SERVO_BOARD_ADDRESS, reg, powerSensorBuffer, length, I2C_Sensor, &powerSensorStatus);
 }
 
 void updateVoltageAndRPM() {
-    i2c_master.requestFrom(0x50, sizeof(POWER_SENSOR_DATA));
-    while(i2c_master.available() < sizeof(POWER_SENSOR_DATA)) {
-        delay(1);
+    while(powerSensorStatus == I2C_Pending) {
+        halDelay(1);
+    }
+    requestPowerSensorData(SERVO_Reg_Analog, sizeof(SERVO_READ_REGISTERS));
+    while(powerSensorStatus == I2C_Pending) {
+        halDelay(1);
+    }
+    if(powerSensorStatus == I2C_Done) {
+        memcpy(&powerSensorData, powerSensorBuffer, sizeof(SERVO_READ_REGISTERS));
+        powerSensorStatus = I2C_Idle;
     }
-    i2c_master.readBytes((uint8_t*)&powerSensorData, sizeof(POWER_SENSOR_DATA));
 }
 
 #pragma endregion
@@ -0,0 +1,807 @@
+/**
+ * Drive control tests
+ * by TerraForce
+ *
+ * Checks every row of both transition tables: its states, group, next direction and state,
+ * commands and when its guard holds, then the if / else if semantics of the row groups in
+ * DRIVE_CONTROL::update with hand-built sensor snapshots and the speed control at the calibration.
+ * Run with "pio test -e native".
+*/
+
+#include <math.h>
+#include <unity.h>
+#include "drive_control.h"
+
+#define MAX_SPEED           11
+
+// row order of the tables, a new row has to be added here and tested
+enum STARTER_ROWS {
+    Starter_Aligned,
+    Starter_OutsideLeft,
+    Starter_OutsideRight,
+    Starter_CurveLeft,
+    Starter_CurveRight,
+    Starter_StartPosition,
+    Starter_CurveFinished,
+    Starter_CurveEndingFinished,
+    Starter_PlanSteering,
+    Starter_WallSteering,
+    Starter_BorderCleared,
+    Starter_LeftVeryNear,
+    Starter_LeftNear,
+    Starter_RightVeryNear,
+    Starter_RightNear,
+    Starter_PlanSpeed,
+    Starter_ApproachingWall,
+    Starter_CorrectionSpeed,
+    Starter_Speed,
+    Starter_Rows
+};
+
+enum OBSTACLE_ROWS {
+    Obstacle_PlanSpeed,
+    Obstacle_ApproachingWall,
+    Obstacle_Idle,
+    Obstacle_OutsideLeft,
+    Obstacle_OutsideRight,
+    Obstacle_CurveLeft,
+    Obstacle_CurveRight,
+    Obstacle_StartPosition,
+    Obstacle_CurveFinished,
+    Obstacle_CurveEndingFinished,
+    Obstacle_PlanSteering,
+    Obstacle_PassLaneSteering,
+    Obstacle_BorderCleared,
+    Obstacle_LeftNear,
+    Obstacle_RightNear,
+    Obstacle_Rows
+};
+
+static DRIVE_CONTROL control;
+
+void setUp() {}
+void tearDown() {}
+
+
+#pragma region helpers
+
+// centered in a 1000 mm corridor with the next wall far ahead
+static SENSOR_SNAPSHOT corridor(uint32_t time) {
+    SENSOR_SNAPSHOT sensors = {};
+    sensors.time = time;
+    sensors.distance[US_LeftFront] = 400;
+    sensors.distance[US_CenterFront] = 2500;
+    sensors.distance[US_RightFront] = 400;
+    sensors.distance[US_LeftBack] = 400;
+    sensors.distance[US_CenterBack] = 500;
+    sensors.distance[US_RightBack] = 400;
+    sensors.objectAge = 0xFFFF;
+    sensors.battery = 8000;
+    return sensors;
+}
+
+static SENSOR_SNAPSHOT withObject(SENSOR_SNAPSHOT sensors, uint8_t color, uint8_t direction) {
+    sensors.object.available = 1;
+    sensors.object.color = color;
+    sensors.object.direction = direction;
+    sensors.objectAge = 0;
+    return sensors;
+}
+
+static void start(uint8_t course, const SENSOR_SNAPSHOT& sensors) {
+    control = DRIVE_CONTROL();
+    control.init(course, MAX_SPEED, sensors);
+}
+
+static void start(uint8_t course) {
+    start(course, corridor(0));
+}
+
+static void setState(uint8_t direction, uint8_t state) {
+    control.driveState.direction = direction;
+    control.driveState.state = state;
+}
+
+static void checkRow(const DRIVE_TABLE& table, uint8_t row, uint8_t states, uint8_t group, uint8_t direction, uint8_t state, int8_t steering, int8_t speed) {
+    const DRIVE_TRANSITION& transition = table.transitions[row];
+    TEST_ASSERT_EQUAL_HEX8_MESSAGE(states, transition.states, "states");
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(group, transition.group, "group");
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(direction, transition.direction, "direction");
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(state, transition.state, "state");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(steering, transition.steering, "steering");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(speed, transition.speed, "speed");
+    TEST_ASSERT_NOT_NULL(transition.guard);
+}
+
+static bool guard(const DRIVE_TABLE& table, uint8_t row, const SENSOR_SNAPSHOT& sensors) {
+    return table.transitions[row].guard(control, sensors);
+}
+
+static void action(const DRIVE_TABLE& table, uint8_t row, const SENSOR_SNAPSHOT& sensors) {
+    TEST_ASSERT_NOT_NULL(table.transitions[row].action);
+    table.transitions[row].action(control, sensors);
+}
+
+#pragma endregion helpers
+
+
+#pragma region table_structure
+
+// an if / else if chain only works on adjacent rows
+static void checkGroupsAdjacent(const DRIVE_TABLE& table) {
+    uint32_t closedGroups = 0;
+    for(uint8_t i = 0; i < table.count; i++) {
+        uint8_t group = table.transitions[i].group;
+        TEST_ASSERT_TRUE(group < 32);
+        TEST_ASSERT_FALSE(closedGroups & (1UL << group));
+        if((i > 0) && (table.transitions[i - 1].group != group) && (table.transitions[i - 1].group > 0)) {
+            closedGroups |= 1UL << table.transitions[i - 1].group;
+        }
+    }
+}
+
+void test_table_sizes() {
+    TEST_ASSERT_EQUAL_UINT8(Starter_Rows, starterCourseTable.count);
+    TEST_ASSERT_EQUAL_UINT8(Obstacle_Rows, obstacleCourseTable.count);
+}
+
+void test_table_groups_adjacent() {
+    checkGroupsAdjacent(starterCourseTable);
+    checkGroupsAdjacent(obstacleCourseTable);
+}
+
+#pragma endregion table_structure
+
+
+#pragma region starter_rows
+
+void test_starter_aligned_to_wall() {
+    const DRIVE_TABLE& table = starterCourseTable;
+    checkRow(table, Starter_Aligned, DRIVE_NOT_CURVING, 0, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    start(StarterCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    TEST_ASSERT_FALSE(guard(table, Starter_Aligned, sensors));
+    control.outsideBorder = Right;
+    TEST_ASSERT_TRUE(guard(table, Starter_Aligned, sensors));
+    sensors.distance[US_RightBack] = 401;
+    TEST_ASSERT_FALSE(guard(table, Starter_Aligned, sensors));
+    sensors = corridor(100);
+    sensors.distance[US_LeftFront] = 700;
+    TEST_ASSERT_FALSE(guard(table, Starter_Aligned, sensors));
+
+    sensors = corridor(100);
+    sensors.rotation = 123;
+    action(table, Starter_Aligned, sensors);
+    TEST_ASSERT_EQUAL_INT32(123, control.antiRotation);
+}
+
+void test_starter_outside_detected() {
+    const DRIVE_TABLE& table = starterCourseTable;
+    checkRow(table, Starter_OutsideLeft, DRIVE_ALL_STATES, 0, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    checkRow(table, Starter_OutsideRight, DRIVE_ALL_STATES, 0, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    start(StarterCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    TEST_ASSERT_FALSE(guard(table, Starter_OutsideLeft, sensors));
+    TEST_ASSERT_FALSE(guard(table, Starter_OutsideRight, sensors));
+    sensors.distance[US_RightFront] = 1101;
+    TEST_ASSERT_TRUE(guard(table, Starter_OutsideLeft, sensors));
+    action(table, Starter_OutsideLeft, sensors);
+    TEST_ASSERT_EQUAL_UINT8(Left, control.outsideBorder);
+    TEST_ASSERT_EQUAL_UINT8(Left, control.outsideBorder2);
+    // decided once
+    TEST_ASSERT_FALSE(guard(table, Starter_OutsideLeft, sensors));
+
+    start(StarterCourse);
+    sensors = corridor(100);
+    sensors.distance[US_LeftFront] = 1101;
+    TEST_ASSERT_TRUE(guard(table, Starter_OutsideRight, sensors));
+    action(table, Starter_OutsideRight, sensors);
+    TEST_ASSERT_EQUAL_UINT8(Right, control.outsideBorder);
+    TEST_ASSERT_EQUAL_UINT8(Right, control.outsideBorder2);
+}
+
+void test_starter_curve_guards() {
+    const DRIVE_TABLE& table = starterCourseTable;
+    checkRow(table, Starter_CurveLeft, DRIVE_NOT_CURVING, 0, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    checkRow(table, Starter_CurveRight, DRIVE_NOT_CURVING, 0, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    start(StarterCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    sensors.distance[US_LeftFront] = 1101;
+    TEST_ASSERT_FALSE(guard(table, Starter_CurveLeft, sensors));
+    control.outsideBorder = Right;
+    TEST_ASSERT_TRUE(guard(table, Starter_CurveLeft, sensors));
+    TEST_ASSERT_FALSE(guard(table, Starter_CurveRight, sensors));
+
+    // without encoder data the next curve waits 4 s
+    control.curveCount = 1;
+    control.lastCurve = 0;
+    sensors.time = 4000;
+    TEST_ASSERT_FALSE(guard(table, Starter_CurveLeft, sensors));
+    sensors.time = 4001;
+    TEST_ASSERT_TRUE(guard(table, Starter_CurveLeft, sensors));
+    control.curveCount = 12;
+    TEST_ASSERT_FALSE(guard(table, Starter_CurveLeft, sensors));
+
+    control.curveCount = 0;
+    control.outsideBorder = Left;
+    sensors = corridor(100);
+    sensors.distance[US_RightFront] = 1101;
+    TEST_ASSERT_TRUE(guard(table, Starter_CurveRight, sensors));
+    TEST_ASSERT_FALSE(guard(table, Starter_CurveLeft, sensors));
+}
+
+void test_starter_curve_start_action() {
+    const DRIVE_TABLE& table = starterCourseTable;
+    start(StarterCourse);
+    control.outsideBorder = Right;
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    sensors.rotation = 50;
+    control.sensors = sensors;
+    action(table, Starter_CurveLeft, sensors);
+    TEST_ASSERT_EQUAL_UINT8(Left, control.driveState.direction);
+    TEST_ASSERT_EQUAL_UINT8(Curve, control.driveState.state);
+    TEST_ASSERT_EQUAL_INT8(-15, control.commands.steering);
+    TEST_ASSERT_EQUAL_INT8(MAX_SPEED - 1, control.commands.speed);
+    TEST_ASSERT_EQUAL_INT32(-1000, control.targetRotation);
+    TEST_ASSERT_EQUAL_INT32(50, control.antiRotation);
+    TEST_ASSERT_EQUAL_UINT8(1, control.curveCount);
+
+    control.driveState.state = Unknown;
+    action(table, Starter_CurveRight, sensors);
+    TEST_ASSERT_EQUAL_UINT8(Right, control.driveState.direction);
+    TEST_ASSERT_EQUAL_INT8(15, control.commands.steering);
+    TEST_ASSERT_EQUAL_INT32(1000, control.targetRotation);
+    TEST_ASSERT_EQUAL_UINT8(2, control.curveCount);
+}
+
+void test_starter_start_position() {
+    const DRIVE_TABLE& table = starterCourseTable;
+    checkRow(table, Starter_StartPosition, DRIVE_NOT_CURVING, 0, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, 0);
+    // without a front distance at the start the field stays unmapped, the front distance decides
+    SENSOR_SNAPSHOT initial = corridor(0);
+    initial.distance[US_CenterFront] = 0;
+    start(StarterCourse, initial);
+    control.outsideBorder = End;
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    sensors.distance[US_CenterFront] = 40;
+    control.curveCount = 11;
+    TEST_ASSERT_FALSE(guard(table, Starter_StartPosition, sensors));
+    control.curveCount = 12;
+    TEST_ASSERT_TRUE(guard(table, Starter_StartPosition, sensors));
+    sensors.distance[US_CenterFront] = 50;
+    TEST_ASSERT_FALSE(guard(table, Starter_StartPosition, sensors));
+    sensors.distance[US_CenterFront] = 0;
+    TEST_ASSERT_FALSE(guard(table, Starter_StartPosition, sensors));
+    sensors.distance[US_CenterFront] = 40;
+    control.sequencer.add({ NULL, 50 });
+    TEST_ASSERT_FALSE(guard(table, Starter_StartPosition, sensors));
+
+    // a mapped field with a trusted pose stops on the pose
+    start(StarterCourse);
+    control.mapField(Right);
+    control.outsideBorder = End;
+    control.curveCount = 12;
+    TEST_ASSERT_TRUE(control.odometry.hasField());
+    sensors = corridor(100);
+    TEST_ASSERT_TRUE(guard(table, Starter_StartPosition, sensors));
+    control.odometry.x = -60;
+    TEST_ASSERT_FALSE(guard(table, Starter_StartPosition, sensors));
+}
+
+void test_starter_curve_end_guards() {
+    const DRIVE_TABLE& table = starterCourseTable;
+    checkRow(table, Starter_CurveFinished, DRIVE_STATE_BIT(Curve), 0, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    checkRow(table, Starter_CurveEndingFinished, DRIVE_STATE_BIT(CurveEnding), 0, Straight, Unknown, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    start(StarterCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    setState(Left, Curve);
+    control.targetRotation = -1000;
+    control.rotation = -999;
+    TEST_ASSERT_FALSE(guard(table, Starter_CurveFinished, sensors));
+    control.rotation = -1000;
+    TEST_ASSERT_TRUE(guard(table, Starter_CurveFinished, sensors));
+
+    setState(Right, Curve);
+    control.targetRotation = 1000;
+    control.rotation = 999;
+    TEST_ASSERT_FALSE(guard(table, Starter_CurveFinished, sensors));
+    // parallel to the outer wall again
+    control.outsideBorder2 = Right;
+    sensors.distance[US_RightBack] = 405;
+    TEST_ASSERT_TRUE(guard(table, Starter_CurveFinished, sensors));
+    control.rotation = 800;
+    TEST_ASSERT_FALSE(guard(table, Starter_CurveFinished, sensors));
+
+    control.rotation = 1000;
+    control.sensors = sensors;
+    action(table, Starter_CurveFinished, sensors);
+    TEST_ASSERT_EQUAL_UINT8(CurveEnding, control.driveState.state);
+    TEST_ASSERT_EQUAL_INT8(0, control.commands.steering);
+    TEST_ASSERT_TRUE(control.sequencer.busy());
+
+    sensors = corridor(100);
+    sensors.distance[US_RightBack] = 1200;
+    TEST_ASSERT_FALSE(guard(table, Starter_CurveEndingFinished, sensors));
+    sensors.distance[US_RightBack] = 1199;
+    TEST_ASSERT_TRUE(guard(table, Starter_CurveEndingFinished, sensors));
+    sensors.distance[US_LeftBack] = 1500;
+    control.driveState.direction = Left;
+    TEST_ASSERT_FALSE(guard(table, Starter_CurveEndingFinished, sensors));
+}
+
+void test_starter_steering_rows() {
+    const DRIVE_TABLE& table = starterCourseTable;
+    checkRow(table, Starter_PlanSteering, DRIVE_CORRECTING_HEADING, 1, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    checkRow(table, Starter_WallSteering, DRIVE_CORRECTING_HEADING, 1, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    start(StarterCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    // nothing is planned in the first lap
+    control.outsideBorder = Right;
+    TEST_ASSERT_FALSE(guard(table, Starter_PlanSteering, sensors));
+    TEST_ASSERT_TRUE(guard(table, Starter_WallSteering, sensors));
+    control.outsideBorder = Unknown;
+    TEST_ASSERT_FALSE(guard(table, Starter_WallSteering, sensors));
+    // the wall side stays known after the course ends
+    control.outsideBorder = End;
+    control.outsideBorder2 = Left;
+    TEST_ASSERT_TRUE(guard(table, Starter_WallSteering, sensors));
+}
+
+void test_starter_border_rows() {
+    const DRIVE_TABLE& table = starterCourseTable;
+    checkRow(table, Starter_BorderCleared, DRIVE_STATE_BIT(BorderCorrection), 0, Straight, Unknown, 0, DRIVE_KEEP_SERVO);
+    checkRow(table, Starter_LeftVeryNear, DRIVE_CORRECTING, 2, Right, BorderCorrection, 10, DRIVE_KEEP_SERVO);
+    checkRow(table, Starter_LeftNear, DRIVE_CORRECTING, 2, Right, BorderCorrection, 7, DRIVE_KEEP_SERVO);
+    checkRow(table, Starter_RightVeryNear, DRIVE_CORRECTING, 2, Left, BorderCorrection, -10, DRIVE_KEEP_SERVO);
+    checkRow(table, Starter_RightNear, DRIVE_CORRECTING, 2, Left, BorderCorrection, -7, DRIVE_KEEP_SERVO);
+    start(StarterCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    TEST_ASSERT_TRUE(guard(table, Starter_BorderCleared, sensors));
+    sensors.distance[US_LeftFront] = 150;
+    TEST_ASSERT_FALSE(guard(table, Starter_BorderCleared, sensors));
+
+    sensors.distance[US_LeftFront] = 79;
+    TEST_ASSERT_TRUE(guard(table, Starter_LeftVeryNear, sensors));
+    TEST_ASSERT_TRUE(guard(table, Starter_LeftNear, sensors));
+    sensors.distance[US_LeftFront] = 80;
+    TEST_ASSERT_FALSE(guard(table, Starter_LeftVeryNear, sensors));
+    TEST_ASSERT_TRUE(guard(table, Starter_LeftNear, sensors));
+    sensors.distance[US_LeftFront] = 120;
+    TEST_ASSERT_FALSE(guard(table, Starter_LeftNear, sensors));
+    // no echo is no border
+    sensors.distance[US_LeftFront] = 0;
+    TEST_ASSERT_FALSE(guard(table, Starter_LeftVeryNear, sensors));
+    TEST_ASSERT_FALSE(guard(table, Starter_LeftNear, sensors));
+
+    sensors = corridor(100);
+    sensors.distance[US_RightFront] = 79;
+    TEST_ASSERT_TRUE(guard(table, Starter_RightVeryNear, sensors));
+    TEST_ASSERT_TRUE(guard(table, Starter_RightNear, sensors));
+    sensors.distance[US_RightFront] = 119;
+    TEST_ASSERT_FALSE(guard(table, Starter_RightVeryNear, sensors));
+    TEST_ASSERT_TRUE(guard(table, Starter_RightNear, sensors));
+    sensors.distance[US_RightFront] = 0;
+    TEST_ASSERT_FALSE(guard(table, Starter_RightNear, sensors));
+}
+
+void test_starter_speed_rows() {
+    const DRIVE_TABLE& table = starterCourseTable;
+    checkRow(table, Starter_PlanSpeed, DRIVE_CORRECTING, 3, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    checkRow(table, Starter_ApproachingWall, DRIVE_CORRECTING, 3, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_MAX_SPEED(2));
+    checkRow(table, Starter_CorrectionSpeed, DRIVE_CORRECTION_ACTIVE, 3, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_MAX_SPEED(3));
+    checkRow(table, Starter_Speed, DRIVE_CORRECTING, 3, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_MAX_SPEED(1));
+    start(StarterCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    TEST_ASSERT_FALSE(guard(table, Starter_PlanSpeed, sensors));
+    TEST_ASSERT_FALSE(guard(table, Starter_ApproachingWall, sensors));
+    TEST_ASSERT_TRUE(guard(table, Starter_Speed, sensors));
+    sensors.distance[US_CenterFront] = 1199;
+    TEST_ASSERT_TRUE(guard(table, Starter_ApproachingWall, sensors));
+
+    // the course end and a running sequence own the speed
+    control.outsideBorder = End;
+    TEST_ASSERT_FALSE(guard(table, Starter_ApproachingWall, sensors));
+    TEST_ASSERT_FALSE(guard(table, Starter_CorrectionSpeed, sensors));
+    TEST_ASSERT_FALSE(guard(table, Starter_Speed, sensors));
+    control.outsideBorder = Right;
+    control.sequencer.add({ NULL, 50 });
+    TEST_ASSERT_FALSE(guard(table, Starter_ApproachingWall, sensors));
+    TEST_ASSERT_FALSE(guard(table, Starter_Speed, sensors));
+}
+
+#pragma endregion starter_rows
+
+
+#pragma region obstacle_rows
+
+void test_obstacle_speed_rows() {
+    const DRIVE_TABLE& table = obstacleCourseTable;
+    checkRow(table, Obstacle_PlanSpeed, DRIVE_NOT_IN_CURVE, 1, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    checkRow(table, Obstacle_ApproachingWall, DRIVE_NOT_IN_CURVE, 1, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, 6);
+    checkRow(table, Obstacle_Idle, DRIVE_NOT_IN_CURVE, 1, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, 8);
+    start(ObstacleCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    TEST_ASSERT_FALSE(guard(table, Obstacle_PlanSpeed, sensors));
+    TEST_ASSERT_FALSE(guard(table, Obstacle_ApproachingWall, sensors));
+    TEST_ASSERT_TRUE(guard(table, Obstacle_Idle, sensors));
+    sensors.distance[US_CenterFront] = 999;
+    TEST_ASSERT_TRUE(guard(table, Obstacle_ApproachingWall, sensors));
+    control.sequencer.add({ NULL, 500 });
+    TEST_ASSERT_FALSE(guard(table, Obstacle_ApproachingWall, sensors));
+    TEST_ASSERT_FALSE(guard(table, Obstacle_Idle, sensors));
+}
+
+void test_obstacle_outside_detected() {
+    const DRIVE_TABLE& table = obstacleCourseTable;
+    checkRow(table, Obstacle_OutsideLeft, DRIVE_ALL_STATES, 0, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    checkRow(table, Obstacle_OutsideRight, DRIVE_ALL_STATES, 0, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    start(ObstacleCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    sensors.distance[US_RightFront] = 1101;
+    TEST_ASSERT_TRUE(guard(table, Obstacle_OutsideLeft, sensors));
+    // the obstacle course keeps the wall side of the steering unknown
+    action(table, Obstacle_OutsideLeft, sensors);
+    TEST_ASSERT_EQUAL_UINT8(Left, control.outsideBorder);
+    TEST_ASSERT_EQUAL_UINT8(Unknown, control.outsideBorder2);
+
+    start(ObstacleCourse);
+    sensors = corridor(100);
+    sensors.distance[US_LeftFront] = 1101;
+    TEST_ASSERT_TRUE(guard(table, Obstacle_OutsideRight, sensors));
+    action(table, Obstacle_OutsideRight, sensors);
+    TEST_ASSERT_EQUAL_UINT8(Right, control.outsideBorder);
+    TEST_ASSERT_EQUAL_UINT8(Unknown, control.outsideBorder2);
+}
+
+void test_obstacle_curve_guards() {
+    const DRIVE_TABLE& table = obstacleCourseTable;
+    checkRow(table, Obstacle_CurveLeft, DRIVE_NOT_CURVING_BORDER, 0, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    checkRow(table, Obstacle_CurveRight, DRIVE_NOT_CURVING_BORDER, 0, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    checkRow(table, Obstacle_StartPosition, DRIVE_NOT_CURVING_BORDER, 0, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, 0);
+    checkRow(table, Obstacle_CurveFinished, DRIVE_STATE_BIT(Curve), 0, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    checkRow(table, Obstacle_CurveEndingFinished, DRIVE_STATE_BIT(CurveEnding), 0, Straight, Unknown, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    start(ObstacleCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    sensors.distance[US_LeftFront] = 1301;
+    TEST_ASSERT_FALSE(guard(table, Obstacle_CurveLeft, sensors));
+    control.outsideBorder = Right;
+    TEST_ASSERT_TRUE(guard(table, Obstacle_CurveLeft, sensors));
+    sensors.distance[US_LeftFront] = 1300;
+    TEST_ASSERT_FALSE(guard(table, Obstacle_CurveLeft, sensors));
+
+    // without encoder data 6 s after a left curve, 8 s after a right one
+    sensors.distance[US_LeftFront] = 1301;
+    control.curveCount = 1;
+    control.lastCurve = 1000;
+    sensors.time = 7000;
+    TEST_ASSERT_FALSE(guard(table, Obstacle_CurveLeft, sensors));
+    sensors.time = 7001;
+    TEST_ASSERT_TRUE(guard(table, Obstacle_CurveLeft, sensors));
+    control.sequencer.add({ NULL, 500 });
+    TEST_ASSERT_FALSE(guard(table, Obstacle_CurveLeft, sensors));
+
+    control.sequencer.clear();
+    control.outsideBorder = Left;
+    sensors = corridor(9001);
+    sensors.distance[US_RightFront] = 1301;
+    TEST_ASSERT_TRUE(guard(table, Obstacle_CurveRight, sensors));
+    sensors.time = 9000;
+    TEST_ASSERT_FALSE(guard(table, Obstacle_CurveRight, sensors));
+    sensors.time = 9001;
+    control.curveCount = 12;
+    TEST_ASSERT_FALSE(guard(table, Obstacle_CurveRight, sensors));
+}
+
+void test_obstacle_steering_rows() {
+    const DRIVE_TABLE& table = obstacleCourseTable;
+    checkRow(table, Obstacle_PlanSteering, DRIVE_CORRECTING, 2, Straight, Unknown, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    checkRow(table, Obstacle_PassLaneSteering, DRIVE_CORRECTING_HEADING, 2, DRIVE_KEEP, DRIVE_KEEP, DRIVE_KEEP_SERVO, DRIVE_KEEP_SERVO);
+    start(ObstacleCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    TEST_ASSERT_FALSE(guard(table, Obstacle_PlanSteering, sensors));
+    TEST_ASSERT_FALSE(guard(table, Obstacle_PassLaneSteering, sensors));
+
+    // the outer side comes from the course map, so it stays known after the course ends
+    control.courseMap.setOuterSide(Left);
+    TEST_ASSERT_TRUE(guard(table, Obstacle_PassLaneSteering, sensors));
+    control.outsideBorder = End;
+    TEST_ASSERT_TRUE(guard(table, Obstacle_PassLaneSteering, sensors));
+
+    // green is passed on the left, so between the car and the outer wall on the left
+    action(table, Obstacle_PassLaneSteering, withObject(corridor(100), 0, 0));
+    TEST_ASSERT_EQUAL_UINT16(COURSE_OUTER_LANE, control.steering.targetOffset);
+    action(table, Obstacle_PassLaneSteering, withObject(corridor(110), 1, 0));
+    TEST_ASSERT_EQUAL_UINT16(COURSE_INNER_LANE, control.steering.targetOffset);
+    // the lane is kept after the pillar left the camera view
+    action(table, Obstacle_PassLaneSteering, corridor(120));
+    TEST_ASSERT_EQUAL_UINT16(COURSE_INNER_LANE, control.steering.targetOffset);
+    control.courseMap.setOuterSide(Right);
+    action(table, Obstacle_PassLaneSteering, withObject(corridor(130), 1, 0));
+    TEST_ASSERT_EQUAL_UINT16(COURSE_OUTER_LANE, control.steering.targetOffset);
+}
+
+// the steering controller holds the pass lane, only the wall itself is avoided with fixed steps
+void test_obstacle_border_rows() {
+    const DRIVE_TABLE& table = obstacleCourseTable;
+    checkRow(table, Obstacle_BorderCleared, DRIVE_STATE_BIT(BorderCorrection), 0, Straight, Unknown, 0, DRIVE_KEEP_SERVO);
+    checkRow(table, Obstacle_LeftNear, DRIVE_CORRECTING, 3, Right, BorderCorrection, 10, DRIVE_KEEP_SERVO);
+    checkRow(table, Obstacle_RightNear, DRIVE_CORRECTING, 3, Left, BorderCorrection, -10, DRIVE_KEEP_SERVO);
+    start(ObstacleCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    TEST_ASSERT_TRUE(guard(table, Obstacle_BorderCleared, sensors));
+    sensors.distance[US_LeftFront] = 150;
+    TEST_ASSERT_FALSE(guard(table, Obstacle_BorderCleared, sensors));
+    TEST_ASSERT_FALSE(guard(table, Obstacle_LeftNear, sensors));
+
+    // the pass lanes are clear of the border rows
+    sensors.distance[US_LeftFront] = COURSE_OUTER_LANE;
+    TEST_ASSERT_FALSE(guard(table, Obstacle_LeftNear, sensors));
+    sensors.distance[US_LeftFront] = 99;
+    TEST_ASSERT_TRUE(guard(table, Obstacle_LeftNear, sensors));
+    TEST_ASSERT_TRUE(guard(table, Obstacle_LeftNear, withObject(sensors, 0, 0)));
+    TEST_ASSERT_TRUE(guard(table, Obstacle_LeftNear, withObject(sensors, 1, 0)));
+    // no echo is no border
+    sensors.distance[US_LeftFront] = 0;
+    TEST_ASSERT_FALSE(guard(table, Obstacle_LeftNear, sensors));
+    sensors = corridor(100);
+    sensors.distance[US_RightFront] = 99;
+    TEST_ASSERT_TRUE(guard(table, Obstacle_RightNear, sensors));
+    sensors.distance[US_RightFront] = 100;
+    TEST_ASSERT_FALSE(guard(table, Obstacle_RightNear, sensors));
+}
+
+#pragma endregion obstacle_rows
+
+
+#pragma region update
+
+// every row of a group is true, only the first one applies
+void test_update_group_first_match_wins() {
+    start(StarterCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    sensors.distance[US_LeftFront] = 70;
+    sensors.distance[US_RightFront] = 70;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(Right, control.driveState.direction);
+    TEST_ASSERT_EQUAL_UINT8(BorderCorrection, control.driveState.state);
+    TEST_ASSERT_EQUAL_INT8(10, control.commands.steering);
+}
+
+// a later row of the same group would lower the speed further
+void test_update_speed_group() {
+    start(StarterCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    sensors.distance[US_CenterFront] = 1000;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_INT8(MAX_SPEED - 2, control.commands.speed);
+
+    sensors = corridor(200);
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_INT8(MAX_SPEED - 1, control.commands.speed);
+
+    // the correction speed applies before the general one
+    sensors = corridor(300);
+    sensors.distance[US_LeftFront] = 100;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(BorderCorrection, control.driveState.state);
+    TEST_ASSERT_EQUAL_INT8(7, control.commands.steering);
+    TEST_ASSERT_EQUAL_INT8(MAX_SPEED - 3, control.commands.speed);
+
+    start(ObstacleCourse);
+    sensors = corridor(100);
+    sensors.distance[US_CenterFront] = 900;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_INT8(6, control.commands.speed);
+}
+
+// rows without a group all apply, in table order and on the state changed by earlier rows
+void test_update_ungrouped_rows_chain() {
+    start(StarterCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    sensors.distance[US_LeftFront] = 1500;
+    sensors.distance[US_LeftBack] = 1500;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(Right, control.outsideBorder);
+    TEST_ASSERT_EQUAL_UINT8(Curve, control.driveState.state);
+    TEST_ASSERT_EQUAL_UINT8(Left, control.driveState.direction);
+    TEST_ASSERT_EQUAL_UINT8(1, control.curveCount);
+    TEST_ASSERT_EQUAL_INT8(-15, control.commands.steering);
+    TEST_ASSERT_EQUAL_INT8(MAX_SPEED - 1, control.commands.speed);
+}
+
+// different groups apply in the same tick, the border group overrides the wall steering
+void test_update_groups_independent() {
+    start(StarterCourse);
+    control.outsideBorder = Right;
+    control.outsideBorder2 = Right;
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    sensors.distance[US_RightFront] = 100;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(BorderCorrection, control.driveState.state);
+    TEST_ASSERT_EQUAL_INT8(-7, control.commands.steering);
+    TEST_ASSERT_EQUAL_INT8(MAX_SPEED - 3, control.commands.speed);
+}
+
+void test_update_starter_curve_ends() {
+    start(StarterCourse);
+    control.outsideBorder = Right;
+    control.outsideBorder2 = Right;
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    sensors.distance[US_LeftFront] = 1500;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(Curve, control.driveState.state);
+
+    sensors = corridor(600);
+    sensors.distance[US_LeftBack] = 1500;
+    sensors.rotation = -1000;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(CurveEnding, control.driveState.state);
+    TEST_ASSERT_TRUE(control.sequencer.busy());
+
+    // the sequence waits 50 ms for the steering from the next tick on, then the speed rows take over again
+    sensors.time = 620;
+    control.update(sensors);
+    sensors.time = 669;
+    control.update(sensors);
+    TEST_ASSERT_TRUE(control.sequencer.busy());
+    TEST_ASSERT_EQUAL_INT8(MAX_SPEED - 1, control.commands.speed);
+    sensors.time = 670;
+    control.update(sensors);
+    TEST_ASSERT_FALSE(control.sequencer.busy());
+    TEST_ASSERT_EQUAL_UINT8(CurveEnding, control.driveState.state);
+
+    sensors.distance[US_LeftBack] = 400;
+    sensors.time = 700;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(Unknown, control.driveState.state);
+    TEST_ASSERT_EQUAL_UINT8(Straight, control.driveState.direction);
+}
+
+// the curve starts in the sequencer 500 ms or 100 mm after it was queued
+void test_update_obstacle_curve_sequence() {
+    start(ObstacleCourse);
+    control.outsideBorder = Right;
+    SENSOR_SNAPSHOT sensors = corridor(1000);
+    sensors.distance[US_LeftFront] = 1500;
+    control.update(sensors);
+    TEST_ASSERT_TRUE(control.sequencer.busy());
+    TEST_ASSERT_EQUAL_UINT8(Unknown, control.driveState.state);
+    TEST_ASSERT_EQUAL_UINT8(0, control.curveCount);
+
+    sensors.time = 1100;
+    control.update(sensors);
+    sensors.time = 1599;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(0, control.curveCount);
+    sensors.time = 1600;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(Curve, control.driveState.state);
+    TEST_ASSERT_EQUAL_UINT8(Left, control.driveState.direction);
+    TEST_ASSERT_EQUAL_UINT8(1, control.curveCount);
+    TEST_ASSERT_EQUAL_INT8(-15, control.commands.steering);
+
+    start(ObstacleCourse);
+    control.outsideBorder = Right;
+    sensors = corridor(1000);
+    sensors.distance[US_LeftFront] = 1500;
+    control.update(sensors);
+    sensors.time = 1100;
+    control.update(sensors);
+    sensors.time = 1150;
+    sensors.motorTurns = 39;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(0, control.curveCount);
+    sensors.time = 1200;
+    sensors.motorTurns = 40;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(1, control.curveCount);
+    TEST_ASSERT_EQUAL_UINT8(Curve, control.driveState.state);
+}
+
+// a red pillar in front of a left curve is passed at speed first
+void test_update_obstacle_curve_after_pillar() {
+    start(ObstacleCourse);
+    control.outsideBorder = Right;
+    SENSOR_SNAPSHOT sensors = withObject(corridor(1000), 1, 0);
+    sensors.distance[US_LeftFront] = 1500;
+    control.update(sensors);
+    sensors.time = 1100;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_INT8(MAX_SPEED - 1, control.commands.speed);
+    sensors.time = 2599;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(0, control.curveCount);
+    sensors.time = 2600;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(1, control.curveCount);
+    TEST_ASSERT_EQUAL_UINT8(Curve, control.driveState.state);
+}
+
+// the twelfth curve ends the course also when the sequencer starts it
+void test_update_course_end() {
+    start(ObstacleCourse);
+    control.outsideBorder = Right;
+    control.curveCount = 11;
+    SENSOR_SNAPSHOT sensors = corridor(20000);
+    sensors.distance[US_LeftFront] = 1500;
+    control.update(sensors);
+    sensors.time = 20100;
+    control.update(sensors);
+    sensors.time = 20600;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(12, control.curveCount);
+    TEST_ASSERT_EQUAL_UINT8(End, control.outsideBorder);
+
+    start(StarterCourse);
+    control.outsideBorder = Right;
+    control.curveCount = 11;
+    control.lastCurve = 0;
+    sensors = corridor(20000);
+    sensors.distance[US_LeftFront] = 1500;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_UINT8(12, control.curveCount);
+    TEST_ASSERT_EQUAL_UINT8(End, control.outsideBorder);
+}
+
+// without the speed loop the speed command drives the motor, the speed is measured anyway
+void test_update_speed_open_loop() {
+    start(StarterCourse);
+    SENSOR_SNAPSHOT sensors = corridor(100);
+    sensors.motorTurns = 40;
+    sensors.motorRpm = 2400;
+    control.update(sensors);
+    TEST_ASSERT_EQUAL_INT8(control.commands.speed, control.commands.motor);
+    TEST_ASSERT_EQUAL_INT16(control.commands.speed * DRIVE_SPEED_STEP, control.commands.velocity);
+    TEST_ASSERT_EQUAL_INT16(800, (int16_t)control.speedControl.speed);
+}
+
+// a car at the calibration keeps the motor commands of the open loop at nominal voltage
+void test_update_speed_closed_loop_baseline() {
+    for(int8_t speed = 1; speed <= MAX_SPEED; speed++) {
+        SPEED_CONTROLLER controller;
+        controller.init(DRIVE_MM_PER_MOTOR_TICK, DRIVE_FEED_FORWARD);
+        float turns = 0;
+        int8_t command = speed;
+        for(uint32_t time = 10; time <= 3000; time += 10) {
+            float wheelSpeed = command * DRIVE_FEED_FORWARD * SPEED_NOMINAL_VOLTAGE;
+            turns += wheelSpeed / DRIVE_MM_PER_MOTOR_TICK / 100;
+            int16_t rpm = lroundf(wheelSpeed * 60 / (SPEED_TICKS_PER_TURN * DRIVE_MM_PER_MOTOR_TICK));
+            command = controller.update(time, (int32_t)turns, rpm, SPEED_NOMINAL_VOLTAGE, speed * DRIVE_SPEED_STEP, true);
+            TEST_ASSERT_EQUAL_INT8(speed, command);
+        }
+    }
+}
+
+#pragma endregion update
+
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_table_sizes);
+    RUN_TEST(test_table_groups_adjacent);
+    RUN_TEST(test_starter_aligned_to_wall);
+    RUN_TEST(test_starter_outside_detected);
+    RUN_TEST(test_starter_curve_guards);
+    RUN_TEST(test_starter_curve_start_action);
+    RUN_TEST(test_starter_start_position);
+    RUN_TEST(test_starter_curve_end_guards);
+    RUN_TEST(test_starter_steering_rows);
+    RUN_TEST(test_starter_border_rows);
+    RUN_TEST(test_starter_speed_rows);
+    RUN_TEST(test_obstacle_speed_rows);
+    RUN_TEST(test_obstacle_outside_detected);
+    RUN_TEST(test_obstacle_curve_guards);
+    RUN_TEST(test_obstacle_steering_rows);
+    RUN_TEST(test_obstacle_border_rows);
+    RUN_TEST(test_update_group_first_match_wins);
+    RUN_TEST(test_update_speed_group);
+    RUN_TEST(test_update_ungrouped_rows_chain);
+    RUN_TEST(test_update_groups_independent);
+    RUN_TEST(test_update_starter_curve_ends);
+    RUN_TEST(test_update_obstacle_curve_sequence);
+    RUN_TEST(test_update_obstacle_curve_after_pillar);
+    RUN_TEST(test_update_course_end);
+    RUN_TEST(test_update_speed_open_loop);
+    RUN_TEST(test_update_speed_closed_loop_baseline);
+    return UNITY_END();
+}
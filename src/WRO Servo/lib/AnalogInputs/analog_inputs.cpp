@@ -0,0 +1,75 @@
+#include "analog_inputs.h"
+#include <util/atomic.h>
+
+#define ANALOG_NO_CHANNEL       0xFF
+
+static uint8_t channels[ANALOG_MAX_CHANNELS];
+static uint8_t channelCount = 0;
+static uint8_t finished = ANALOG_NO_CHANNEL;   // channel of the conversion that just completed
+static uint8_t running = 0;                     // channel of the conversion started with it
+
+static uint16_t sums[ANALOG_MAX_CHANNELS];
+static uint8_t rounds = 0;
+static uint16_t history[ANALOG_MAX_CHANNELS][ANALOG_AVERAGE_SIZE];
+static uint16_t historySums[ANALOG_MAX_CHANNELS];
+static uint8_t historyIndex = 0;
+
+static volatile uint16_t buffers[2][ANALOG_MAX_CHANNELS];
+static volatile uint8_t front = 0;
+
+// the servo timers may interrupt the ADC, the next conversion completes only 104 us later
+ISR(ADC_vect, ISR_NOBLOCK) {
+    uint16_t sample = ADC;
+
+    // in free running mode the next conversion already started, a new channel applies to the one after it
+    uint8_t channel = finished;
+    finished = running;
+    running = (running + 1 < channelCount) ? running + 1 : 0;
+    ADMUX = (1 << REFS0) | channels[running];
+    if(channel == ANALOG_NO_CHANNEL) return;
+
+    sums[channel] += sample;
+    if(channel + 1 < channelCount) return;
+    if(++rounds < ANALOG_OVERSAMPLING) return;
+
+    uint8_t back = front ^ 1;
+    for(uint8_t i = 0; i < channelCount; i++) {
+        uint16_t value = sums[i] >> 2;
+        historySums[i] += value - history[i][historyIndex];
+        history[i][historyIndex] = value;
+        buffers[back][i] = historySums[i] / ANALOG_AVERAGE_SIZE;
+        sums[i] = 0;
+    }
+    historyIndex = (historyIndex + 1) % ANALOG_AVERAGE_SIZE;
+    rounds = 0;
+    front = back;
+}
+
+bool ANALOG_INPUTS::add(uint8_t pin) {
+    if(channelCount >= ANALOG_MAX_CHANNELS) return false;
+    uint8_t channel = (pin >= A0) ? pin - A0 : pin;
+    // A6 and A7 have no digital input buffer
+    if(channel < 6) {
+        DIDR0 |= 1 << channel;
+    }
+    channels[channelCount++] = channel;
+    return true;
+}
+
+void ANALOG_INPUTS::init() {
+    if(channelCount == 0) return;
+    cli();
+    ADMUX = (1 << REFS0) | channels[0];
+    ADCSRB = 0;
+    // 125 kHz ADC clock, a conversion every 104 us
+    ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADATE) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+    sei();
+}
+
+void ANALOG_INPUTS::read(uint16_t* values) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for(uint8_t i = 0; i < channelCount; i++) {
+            values[i] = buffers[front][i];
+        }
+    }
+}
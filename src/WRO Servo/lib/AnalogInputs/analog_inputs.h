@@ -0,0 +1,31 @@
+#ifndef ANALOG_INPUTS_H
+#define ANALOG_INPUTS_H
+
+/**
+ * Free running ADC library for ATMega328 MCUs
+ * by TerraForce
+ *
+ * The conversion complete interrupt cycles through the channels, sums ANALOG_OVERSAMPLING
+ * samples per channel into a 12 bit value and averages the last ANALOG_AVERAGE_SIZE of them.
+ * Every finished round of all channels is published through a double buffer.
+*/
+
+#define ANALOG_INPUTS_LIB_VERSION "1.0.0"
+
+#include <Arduino.h>
+
+#define ANALOG_MAX_CHANNELS     8
+#define ANALOG_OVERSAMPLING     16      // 10 bit samples per 12 bit value
+#define ANALOG_AVERAGE_SIZE     4       // 12 bit values in the moving average
+
+class ANALOG_INPUTS {
+    public:
+        // channels are sampled in the order they are added, init starts the conversions
+        bool add(uint8_t pin);
+        void init();
+
+        // 12 bit values of the last published round, 0 until the first one
+        void read(uint16_t* values);
+};
+
+#endif
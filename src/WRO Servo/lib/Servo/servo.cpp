@@ -1,42 +1,70 @@
 #include "servo.h"
+#include <util/atomic.h>
 
-uint8_t nextServo = 0;
+static SERVO servos[SERVO_MAX_COUNT];
+static uint8_t servoCount = 0;
+static volatile bool changed = false;
+
+// the frame interrupt swaps in a pending schedule, update only writes the other one
+static SERVOSCHEDULE schedules[2];
+static volatile uint8_t active = 0;
+static volatile bool pending = false;
+static const SERVOSCHEDULE* running = NULL;
+static uint8_t nextDrop = 0;
+static uint16_t riseTime = 0;
+
+static void updateProfiles();
 
 ISR(TIMER1_COMPA_vect) {
-    if(servoData.initCount > 1) { 
-        cli();
-        OCR2A = servoData.servos[0].delay;
-        TIMSK2 |= 1 << OCIE2A;
-        TCCR2A = 1 << WGM21;
-        TCCR2B = (1 << CS22) | (1 << CS21);
-        sei();
-        nextServo = 0;
+    if(pending) {
+        active ^= 1;
+        pending = false;
+    }
+    running = &schedules[active];
+    if(running->dropCount > 0) {
+        for(uint8_t i = 0; i < running->riseCount; i++) {
+            *running->rises[i].port |= running->rises[i].mask;
+        }
+        // the drops are timed from the rise, the latency of this interrupt does not change the widths
+        riseTime = TCNT1;
+        nextDrop = 0;
+        OCR1B = riseTime + running->drops[0].time;
+        TIFR1 = 1 << OCF1B;
+        TIMSK1 |= 1 << OCIE1B;
     }
+
+    // the drops of this frame may interrupt the motion profiles, their pulses apply from the next frame
+    sei();
+    updateProfiles();
 }
 
-ISR(TIMER2_COMPA_vect) {
-    ::digitalWrite(servoData.servos[nextServo].pin, LOW);
-    nextServo++;
-    if(nextServo >= servoData.initCount) {
-        cli();
-        TIMSK2 ^= 1 << OCIE2A;
-        TCCR2A = 0;
-        TCCR2B = 0;
-        TCNT2 = 0;
-        sei();
-    }
-    else {
-        ::digitalWrite(servoData.servos[nextServo].pin, HIGH);
-        cli();
-        OCR2A = servoData.servos[nextServo].delay;
-        sei();
+ISR(TIMER1_COMPB_vect) {
+    while(nextDrop < running->dropCount) {
+        const SERVOEDGE& edge = running->drops[nextDrop];
+        uint16_t due = riseTime + edge.time;
+        // a compare value that already passed would only match in the next frame
+        if(due > TCNT1 + SERVO_ISR_TICKS) {
+            OCR1B = due;
+            return;
+        }
+        while(TCNT1 < due) {}
+        *edge.port &= ~edge.mask;
+        nextDrop++;
     }
+    TIMSK1 &= ~(1 << OCIE1B);
 }
 
-void SERVOS::init(const uint8_t count) {
-    servoData.servos = new SERVO[count + 1];
-    maxCount = count + 1;
+static void addEdge(SERVOEDGE* edges, uint8_t& count, uint16_t time, volatile uint8_t* port, uint8_t mask) {
+    for(uint8_t i = 0; i < count; i++) {
+        if((edges[i].time == time) && (edges[i].port == port)) {
+            edges[i].mask |= mask;
+            return;
+        }
+    }
+    edges[count++] = { time, port, mask };
+}
 
+void SERVOS::init() {
     cli();
     TCCR1A = 0;
     TCCR1B = (1 << WGM12) | (1 << CS11);
@@ -44,27 +72,155 @@ void SERVOS::init(const uint8_t count) {
     OCR1A = 39999;
     TIMSK1 |= 1 << OCIE1A;
     sei();
+}
 
-    this->set(255, 500);
+uint8_t SERVOS::attach(uint8_t pin, SERVORANGE range) {
+    if(servoCount >= SERVO_MAX_COUNT) return SERVO_NONE;
+    uint8_t port = digitalPinToPort(pin);
+    if(port == NOT_A_PIN) return SERVO_NONE;
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+    servos[servoCount] = { pin, portOutputRegister(port), digitalPinToBitMask(pin), 0, 0, range, {} };
+    count = ++servoCount;
+    set(servoCount - 1, 0);
+    return servoCount - 1;
 }
 
-void SERVOS::set(uint8_t pin, int16_t value, SERVORANGE range) {
-    uint8_t index = 255;
-    for(uint8_t i = 0; i < servoData.initCount; i++) {
-        if(servoData.servos[i].pin == pin) {
-            index = i;
+static uint32_t squareRoot(uint32_t value) {
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    while(bit > value) {
+        bit >>= 2;
+    }
+    while(bit != 0) {
+        if(value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else {
+            root >>= 1;
         }
+        bit >>= 2;
     }
-    if(index != 255) {
-        servoData.servos[index].delay = SERVO_ANGLE_TO_256CLK(value);
-        servoData.servos[index].range = range;
+    return root;
+}
+
+static bool hasProfile(const SERVO& servo) {
+    return (servo.profile.maxVelocity != 0) || (servo.profile.maxAcceleration != 0);
+}
+
+static void setPulseTicks(SERVO& servo, uint16_t pulse) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if(servo.pulse != pulse) {
+            servo.pulse = pulse;
+            changed = true;
+        }
     }
-    else if(servoData.initCount < maxCount) {
-        servoData.servos[servoData.initCount].pin = pin;
-        servoData.servos[servoData.initCount].delay = SERVO_ANGLE_TO_256CLK(value);
-        servoData.servos[servoData.initCount].range = range;
-        pinMode(pin, OUTPUT);
-        digitalWrite(pin, LOW);
-        servoData.initCount++;
+}
+
+// never faster than allows to stop at the target in whole frames: v (v + a) / 2a <= distance
+static void updateProfiles() {
+    for(uint8_t i = 0; i < servoCount; i++) {
+        SERVO& servo = servos[i];
+        SERVOPROFILE& profile = servo.profile;
+        if(!hasProfile(servo)) continue;
+        int32_t target;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            target = (int32_t)servo.target * SERVO_PROFILE_SCALE;
+        }
+        int32_t error = target - profile.position;
+        int32_t distance = labs(error);
+        int32_t acceleration = profile.maxAcceleration;
+        if((error == 0) && (profile.velocity == 0)) continue;
+
+        if((acceleration > 0) && (distance <= acceleration) && (labs(profile.velocity) <= acceleration)) {
+            profile.position = target;
+            profile.velocity = 0;
+        }
+        else {
+            int32_t speed = distance;
+            if((profile.maxVelocity > 0) && (speed > profile.maxVelocity)) {
+                speed = profile.maxVelocity;
+            }
+            if(acceleration > 0) {
+                int32_t stop = (squareRoot(acceleration * acceleration + 8 * acceleration * distance) - acceleration) / 2;
+                speed = (speed < stop) ? speed : stop;
+                int32_t change = ((error < 0) ? -speed : speed) - profile.velocity;
+                profile.velocity += constrain(change, -acceleration, acceleration);
+            }
+            else {
+                profile.velocity = (error < 0) ? -speed : speed;
+            }
+            profile.position += profile.velocity;
+        }
+        setPulseTicks(servo, (profile.position + SERVO_PROFILE_SCALE / 2) / SERVO_PROFILE_SCALE);
+    }
+}
+
+static void setTicks(uint8_t channel, int32_t ticks) {
+    SERVO& servo = servos[channel];
+    uint16_t pulse = constrain(ticks, SERVO_US_TO_TICKS(SERVO_MIN_PULSE), SERVO_US_TO_TICKS(SERVO_MAX_PULSE));
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        servo.target = pulse;
+    }
+    // channels with a motion profile follow their target in the frame interrupt
+    if(!hasProfile(servo)) {
+        setPulseTicks(servo, pulse);
+    }
+}
+
+void SERVOS::set(uint8_t channel, int16_t angle) {
+    if(channel >= servoCount) return;
+    const SERVORANGE& range = servos[channel].range;
+    angle = constrain(angle, -900, 900);
+    setTicks(channel, (int32_t)(range.min + range.max) + ((int32_t)angle * (range.max - range.min)) / 900);
+}
+
+void SERVOS::setPulse(uint8_t channel, uint16_t pulse) {
+    if(channel >= servoCount) return;
+    setTicks(channel, SERVO_US_TO_TICKS(pulse));
+}
+
+void SERVOS::setProfile(uint8_t channel, uint16_t speed, uint16_t acceleration) {
+    if(channel >= servoCount) return;
+    SERVO& servo = servos[channel];
+    float steps = 2.0 * (servo.range.max - servo.range.min) / 180 * SERVO_PROFILE_SCALE;
+    // the acceleration limit keeps 8 a distance within 32 bits
+    float maxVelocity = (speed > 0) ? constrain(speed * steps * SERVO_FRAME_TIME, 1, UINT16_MAX) : 0;
+    float maxAcceleration = (acceleration > 0) ? constrain(acceleration * steps * SERVO_FRAME_TIME * SERVO_FRAME_TIME, 1, 2500) : 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        servo.profile = { (int32_t)servo.pulse * SERVO_PROFILE_SCALE, 0, (uint16_t)maxVelocity, (uint16_t)maxAcceleration };
+    }
+    setTicks(channel, servo.target);
+}
+
+void SERVOS::update() {
+    if(!changed) return;
+    SERVOSCHEDULE* schedule;
+    uint16_t pulses[SERVO_MAX_COUNT];
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        changed = false;
+        pending = false;
+        schedule = &schedules[active ^ 1];
+        for(uint8_t i = 0; i < servoCount; i++) {
+            pulses[i] = servos[i].pulse;
+        }
     }
+
+    schedule->riseCount = 0;
+    schedule->dropCount = 0;
+    for(uint8_t i = 0; i < servoCount; i++) {
+        addEdge(schedule->rises, schedule->riseCount, 0, servos[i].port, servos[i].mask);
+        addEdge(schedule->drops, schedule->dropCount, pulses[i], servos[i].port, servos[i].mask);
+    }
+    for(uint8_t i = 1; i < schedule->dropCount; i++) {
+        SERVOEDGE edge = schedule->drops[i];
+        uint8_t j = i;
+        for(; (j > 0) && (schedule->drops[j - 1].time > edge.time); j--) {
+            schedule->drops[j] = schedule->drops[j - 1];
+        }
+        schedule->drops[j] = edge;
+    }
+
+    pending = true;
 }
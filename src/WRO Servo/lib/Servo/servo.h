@@ -4,36 +4,85 @@
 /**
  * Servo library for ATMega328 MCUs
  * by TerraForce
+ *
+ * Timer1 counts the 20 ms frame in 0.5 us ticks. Its frame interrupt raises all servo pins
+ * together, the compare B interrupt drops every pin at its pulse width. Pins are written
+ * through precomputed port masks, the schedule is sorted by pulse width and swapped in at
+ * the start of a frame.
+ * Channels with a motion profile move to their target with limited speed and acceleration,
+ * the frame interrupt advances them once per frame.
 */
 
 #define SERVO_LIB_VERSION "1.0.0"
 
 #include <Arduino.h>
 
-#define SERVO_ANGLE_TO_256CLK(angle) (((uint8_t)round((1500 + (angle * (1000.0 / 180))) / 16.0)) - 1)
+#define SERVO_MAX_COUNT     8
+#define SERVO_NONE          0xFF
+#define SERVO_MIN_PULSE     500     // us
+#define SERVO_MAX_PULSE     2500    // us
+#define SERVO_ISR_TICKS     20      // drops closer than this to the previous one are waited for in the interrupt
+#define SERVO_PROFILE_SCALE 16      // motion profile steps per Timer1 tick
+#define SERVO_FRAME_TIME    0.02    // s
 
+#define SERVO_US_TO_TICKS(us)   ((uint16_t)(us) * 2)
+
+// pulse widths at -90 and 90 degrees in us, angles in between are interpolated
 struct SERVORANGE {
     int16_t min;
     int16_t max;
 };
 
+// positions and limits in 1/SERVO_PROFILE_SCALE Timer1 ticks and frames, a limit of 0 is unlimited
+struct SERVOPROFILE {
+    int32_t position;
+    int32_t velocity;           // per frame
+    uint16_t maxVelocity;       // per frame
+    uint16_t maxAcceleration;   // per frame and frame
+};
+
 struct SERVO {
     uint8_t pin;
-    uint8_t delay;
+    volatile uint8_t* port;
+    uint8_t mask;
+    uint16_t pulse;     // Timer1 ticks of the next frames
+    uint16_t target;    // Timer1 ticks the motion profile moves the pulse to
     SERVORANGE range;
+    SERVOPROFILE profile;
+};
+
+// pins of one port that change at the same tick
+struct SERVOEDGE {
+    uint16_t time;      // Timer1 ticks after the rise
+    volatile uint8_t* port;
+    uint8_t mask;
 };
 
-struct SERVODATA {
-    SERVO* servos = NULL;
-    uint8_t initCount = 0;
-} static servoData;
+struct SERVOSCHEDULE {
+    SERVOEDGE rises[SERVO_MAX_COUNT];
+    SERVOEDGE drops[SERVO_MAX_COUNT];   // sorted by time
+    uint8_t riseCount;
+    uint8_t dropCount;
+};
 
 class SERVOS {
     public:
-        void init(const uint8_t count);
-        void set(uint8_t pin, int16_t value, SERVORANGE range = {-90, 90});
+        void init();
+
+        // returns the channel of the pin or SERVO_NONE
+        uint8_t attach(uint8_t pin, SERVORANGE range = {1000, 2000});
+
+        // angle in 1/10 degrees from -900 to 900, calibrated by the range of the channel
+        void set(uint8_t channel, int16_t angle);
+        void setPulse(uint8_t channel, uint16_t pulse);
+
+        // limits in degrees per second and degrees per second², 0 is unlimited
+        void setProfile(uint8_t channel, uint16_t speed, uint16_t acceleration);
+
+        // prepares changed pulse widths for the next frame, call from the loop
+        void update();
 
-        uint8_t maxCount = 0;
+        uint8_t count = 0;
 };
 
 #endif
@@ -5,11 +5,26 @@
 
 #define WRO_SERVO_VERSION "1.1.0"
 
+// encoder edges per motor turn and the time without an edge that counts as standing
+#define Encoder_Edges_Per_Turn      8
+#define Encoder_Timeout             100000  // us
+
+// the interrupt pins are channel A and B of one motor encoder, encoder 0 counts signed and encoder 1 stays unused
+// #define ENCODER_QUADRATURE
+
+// motion profiles of the PWM channels, the motor ramps its command and the steering servo eases in and out
+#define Profile_Speed               (uint16_t[]){ 450, 0, 0, 0 }       // degrees/s, 0 is unlimited
+#define Profile_Acceleration        (uint16_t[]){ 0, 6000, 0, 0 }      // degrees/s², 0 is unlimited
+
 
 #pragma region includes
 
 #include <Arduino.h>
-#include <Wire.h>
+#include <string.h>
+#include <util/atomic.h>
+#include "hal.h"
+#include "servo_registers.h"
+#include <analog_inputs.h>
 #include <servo.h>
 
 #pragma endregion includes
@@ -27,13 +42,24 @@
 
 #pragma region global_properties
 
-struct SENSOR_DATA {
-    uint16_t analogValues[4];
-    uint32_t motorTurns[2];
-} sensorData = {};
+// encoder counts are kept up to date by their interrupts, ADC values and speeds are taken on request
+SERVO_READ_REGISTERS sensorData = {};
+
+struct ENCODER {
+    uint32_t lastEdge;  // us
+    uint32_t period;    // between the last two edges in us, 0 after standing
+    int8_t direction;
+} encoders[2] = {};
+
+// written by the I2C interrupt, applied in the loop
+SERVO_WRITE_REGISTERS registers = {};
+SERVO_WRITE_REGISTERS appliedRegisters = {};
+volatile bool registersReceived = false;
+uint8_t readAddress = SERVO_Reg_Analog;
 
-TwoWire i2c = Wire;
+HAL_I2C i2c(0);
 SERVOS servo;
+ANALOG_INPUTS analogInputs;
 bool i2cRequestWorking = false;
 
 #pragma endregion global_properties
@@ -43,75 +69,144 @@ bool i2cRequestWorking = false;
 
 void interruptFunction1();
 void interruptFunction2();
-void i2cOnRequestGuardFunction();
-void i2cOnRequestFunction();
-void i2cOnReceiveFunction(int bytes);
+void encoderEdge(uint8_t index, int8_t direction);
+int16_t encoderRpm(uint8_t index, uint32_t time);
+size_t i2cOnRequestGuardFunction(uint8_t* data, size_t maxLength);
+size_t i2cOnRequestFunction(uint8_t* data, size_t maxLength);
+void i2cOnReceiveFunction(const uint8_t* data, size_t length);
+void applyRegisters();
 
 #pragma endregion functions
 
 void setup() {
 
-    i2c.setClock(400000);
-    i2c.begin(0x50);
-
     for(uint8_t i = 0; i < 2; i++) {
-        pinMode(Pins_Interrupt[i], INPUT);
+        halPinMode(Pins_Interrupt[i], HAL_Input);
     }
 
     for(uint8_t i = 0; i < 8; i++) {
-        pinMode(Pins_LEDs[i], OUTPUT);
-        digitalWrite(Pins_LEDs[i], LOW);
+        halPinMode(Pins_LEDs[i], HAL_Output);
+        halDigitalWrite(Pins_LEDs[i], false);
     }
 
-    servo.init(4);
+    servo.init();
     for(uint8_t i = 0; i < 4; i++) {
-        servo.set(Pins_PWM[i], 0);
+        servo.attach(Pins_PWM[i]);
+        servo.setProfile(i, Profile_Speed[i], Profile_Acceleration[i]);
+        // outside the angle range, so the first write starts the pulses
+        appliedRegisters.targets[i] = INT16_MIN;
     }
 
     for(uint8_t i = 0; i < 4; i++) {
-        pinMode(Pins_ADC[i], INPUT);
+        halPinMode(Pins_ADC[i], HAL_Input);
+        analogInputs.add(Pins_ADC[i]);
     }
+    analogInputs.init();
 
-    attachInterrupt(digitalPinToInterrupt(Pins_Interrupt[0]), interruptFunction1, RISING);
-    attachInterrupt(digitalPinToInterrupt(Pins_Interrupt[1]), interruptFunction2, RISING);
+    halAttachInterrupt(Pins_Interrupt[0], interruptFunction1, HAL_Rising);
+    #ifndef ENCODER_QUADRATURE
+        halAttachInterrupt(Pins_Interrupt[1], interruptFunction2, HAL_Rising);
+    #endif
 
-    i2c.onRequest(i2cOnRequestGuardFunction);
-    i2c.onReceive(i2cOnReceiveFunction);
+    i2c.beginSlave(SERVO_BOARD_ADDRESS, SDA, SCL, 400000, i2cOnReceiveFunction, i2cOnRequestGuardFunction);
 }
 
-void loop() {}
+void loop() {
+    if(registersReceived) {
+        applyRegisters();
+    }
+    servo.update();
+}
 
 void interruptFunction1() {
-    sensorData.motorTurns[0]++;
+    #ifdef ENCODER_QUADRATURE
+        // channel B leads channel A when driving backwards
+        encoderEdge(0, halDigitalRead(Pins_Interrupt[1]) ? -1 : 1);
+    #else
+        encoderEdge(0, 1);
+    #endif
 }
 
 void interruptFunction2() {
-    sensorData.motorTurns[1]++;
+    encoderEdge(1, 1);
+}
+
+void encoderEdge(uint8_t index, int8_t direction) {
+    uint32_t time = micros();
+    ENCODER& encoder = encoders[index];
+    // the first edge after standing has no period, a change of direction neither
+    bool moving = (encoder.lastEdge != 0) && (time - encoder.lastEdge < Encoder_Timeout) && (encoder.direction == direction);
+    encoder.period = moving ? time - encoder.lastEdge : 0;
+    encoder.lastEdge = time;
+    encoder.direction = direction;
+    sensorData.motorTurns[index] += direction;
 }
 
-void i2cOnRequestGuardFunction() {
+// the motor is at most as fast as the time since the last edge allows
+int16_t encoderRpm(uint8_t index, uint32_t time) {
+    const ENCODER& encoder = encoders[index];
+    uint32_t sinceEdge = time - encoder.lastEdge;
+    if((encoder.period == 0) || (sinceEdge >= Encoder_Timeout)) return 0;
+    uint32_t period = (sinceEdge > encoder.period) ? sinceEdge : encoder.period;
+    uint32_t rpm = 60000000UL / (period * Encoder_Edges_Per_Turn);
+    rpm = (rpm > INT16_MAX) ? INT16_MAX : rpm;
+    return (encoder.direction < 0) ? -(int16_t)rpm : (int16_t)rpm;
+}
+
+size_t i2cOnRequestGuardFunction(uint8_t* data, size_t maxLength) {
+    size_t length = 0;
     if(!i2cRequestWorking) {
         i2cRequestWorking = true;
-        i2cOnRequestFunction();
+        length = i2cOnRequestFunction(data, maxLength);
         i2cRequestWorking = false;
     }
+    return length;
 }
 
-void i2cOnRequestFunction() {
-    for(uint8_t i = 0; i < 4; i++) {
-        sensorData.analogValues[i] = analogRead(Pins_ADC[i]);
+// runs in the I2C interrupt, the encoders cannot change while they are copied
+size_t i2cOnRequestFunction(uint8_t* data, size_t maxLength) {
+    if((readAddress < SERVO_Reg_Analog) || (readAddress >= SERVO_Reg_Read_End)) return 0;
+    uint16_t analogValues[4];
+    analogInputs.read(analogValues);
+    memcpy(sensorData.analogValues, analogValues, sizeof(analogValues));
+    uint32_t time = micros();
+    for(uint8_t i = 0; i < 2; i++) {
+        sensorData.motorRpm[i] = encoderRpm(i, time);
     }
-    i2c.write((uint8_t*)&sensorData, sizeof(SENSOR_DATA));
+    size_t length = min((size_t)(SERVO_Reg_Read_End - readAddress), maxLength);
+    memcpy(data, (uint8_t*)&sensorData + (readAddress - SERVO_Reg_Analog), length);
+    return length;
 }
 
-void i2cOnReceiveFunction(int bytes) {
-    for(uint8_t i = 0; i < bytes; i++) {
-        uint8_t command = i2c.read();
-        if(command & 0b10000000) {
-            digitalWrite(Pins_LEDs[(command & 0b1111110) >> 1], command & 0b1);
+// runs in the I2C interrupt, only the bytes are stored, the first byte addresses a register, bytes beyond the register map are ignored
+void i2cOnReceiveFunction(const uint8_t* data, size_t length) {
+    if(length < 1) return;
+    readAddress = data[0];
+    if(length < 2) return;
+    uint8_t address = data[0];
+    for(size_t i = 1; (i < length) && (address < SERVO_Reg_Write_End); i++) {
+        ((uint8_t*)&registers)[address++] = data[i];
+    }
+    registersReceived = true;
+}
+
+// WRO Main writes every register each tick, only channels and lights with new values are touched
+void applyRegisters() {
+    SERVO_WRITE_REGISTERS received;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        received = registers;
+        registersReceived = false;
+    }
+    for(uint8_t i = 0; i < SERVO_CHANNELS; i++) {
+        if(received.targets[i] != appliedRegisters.targets[i]) {
+            servo.set(i, received.targets[i]);
         }
-        else {
-            servo.set(Pins_PWM[(command & 0b1100000) >> 5], command & 0b10000 ? ((command & 0b1111) * 6) : -((command & 0b1111) * 6));
+    }
+    uint8_t lights = received.lights ^ appliedRegisters.lights;
+    for(uint8_t i = 0; i < SERVO_LIGHTS; i++) {
+        if(lights & (1 << i)) {
+            halDigitalWrite(Pins_LEDs[i], received.lights & (1 << i));
         }
     }
+    appliedRegisters = received;
 }
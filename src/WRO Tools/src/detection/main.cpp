@@ -0,0 +1,65 @@
+/**
+ * Object detection benchmark
+ * by TerraForce
+ *
+ * Runs the image correction and object detection of WRO Camera on BMP files written
+ * by CAMERA::save through the native camera of the HAL and reports the detected
+ * object and the processing time per frame.
+ * Usage: detection [--repeat <n>] <image.bmp> ...
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "hal.h"
+#include "camera.h"
+#include "object_detection.h"
+
+int main(int argc, char** argv) {
+    uint32_t repeat = 100;
+    int first = 1;
+    if((argc > 2) && (strcmp(argv[1], "--repeat") == 0)) {
+        repeat = strtoul(argv[2], NULL, 10);
+        first = 3;
+    }
+    if((first >= argc) || (repeat == 0)) {
+        fprintf(stderr, "Usage: detection [--repeat <n>] <image.bmp> ...\n");
+        return 1;
+    }
+
+    CAMERA camera;
+    int failed = 0;
+    for(int i = first; i < argc; i++) {
+        if(!halNativeCameraFile(argv[i])) {
+            fprintf(stderr, "%s: no 24 bit BMP file\n", argv[i]);
+            failed++;
+            continue;
+        }
+
+        // every capture copies the original frame, the correction works in place
+        DETECTED_OBJECT object = {};
+        double correction = 0;
+        double detection = 0;
+        for(uint32_t j = 0; j < repeat; j++) {
+            camera.capture();
+            auto begin = std::chrono::steady_clock::now();
+            correctImage(camera);
+            auto corrected = std::chrono::steady_clock::now();
+            object = detectObject(camera);
+            auto end = std::chrono::steady_clock::now();
+            correction += std::chrono::duration<double, std::micro>(corrected - begin).count();
+            detection += std::chrono::duration<double, std::micro>(end - corrected).count();
+        }
+
+        printf("%s: %ux%u, ", argv[i], camera.width, camera.height);
+        if(object.available) {
+            printf("%s object %s, angle %u", (object.color == Red) ? "red" : "green", object.direction ? "right" : "left", object.angle);
+        }
+        else {
+            printf("no object");
+        }
+        printf(" at pixel %u %u, correction %.1f us, detection %.1f us\n", object.x, object.y, correction / repeat, detection / repeat);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * Drive control replay
+ * by TerraForce
+ *
+ * Feeds a recording of WRO Main (built with RECORDING) through the drive control
+ * and compares the actuator commands against the recorded ones, as fast as possible.
+ * Usage: replay [--verbose] [--csv <file>] <recording>
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "recorder.h"
+
+int main(int argc, char** argv) {
+    const char* recordingPath = NULL;
+    const char* csvPath = NULL;
+    bool verbose = false;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--verbose") == 0) verbose = true;
+        else if((strcmp(argv[i], "--csv") == 0) && (i + 1 < argc)) csvPath = argv[++i];
+        else recordingPath = argv[i];
+    }
+    FILE* input = recordingPath ? fopen(recordingPath, "rb") : NULL;
+    if(input == NULL) {
+        fprintf(stderr, "Usage: replay [--verbose] [--csv <file>] <recording>\n");
+        return 1;
+    }
+    FILE* csv = csvPath ? fopen(csvPath, "w") : NULL;
+    if(csv != NULL) {
+        fprintf(csv, "time,motor,steering,replay_motor,replay_steering,direction,state,curve_count\n");
+    }
+
+    static ULTRASONIC ultrasonic;
+    static DRIVE_CONTROL control;
+    bool configured = false;
+    bool started = false;
+    uint32_t ticks = 0;
+    uint32_t mismatches = 0;
+    uint32_t broken = 0;
+    uint16_t dropped = 0;
+    uint32_t firstTime = 0;
+    uint32_t lastTime = 0;
+    double updateTime = 0;
+    double maxUpdateTime = 0;
+
+    uint8_t frame[RECORD_MAX_FRAME];
+    size_t length = 0;
+    bool overflow = false;
+    int c;
+    while((c = fgetc(input)) != EOF) {
+        if(c != FRAMING_DELIMITER) {
+            if(length < sizeof(frame)) frame[length++] = (uint8_t)c;
+            else overflow = true;
+            continue;
+        }
+        RECORD record;
+        bool valid = !overflow && (length > 0) && recordDecode(frame, length, &record);
+        broken += !valid && (length > 0);
+        length = 0;
+        overflow = false;
+        if(!valid) continue;
+
+        if(record.type == RECORD_Config) {
+            if(record.config.version != RECORD_VERSION) {
+                fprintf(stderr, "Recording version %u, replay expects %u\n", record.config.version, RECORD_VERSION);
+                return 1;
+            }
+            ultrasonic.init(record.config.filterSize, record.config.outlierThreshold, record.config.maxAge);
+            configured = true;
+            continue;
+        }
+        if(!configured) continue;
+        if(record.type == RECORD_Ultrasonic) {
+            ultrasonic.add(record.ultrasonic.sensor, record.ultrasonic.distance, record.ultrasonic.time, record.ultrasonic.valid);
+            continue;
+        }
+        if((record.type != RECORD_Start) && !started) continue;
+
+        const RECORD_TICK& tick = (record.type == RECORD_Start) ? record.start.tick : record.tick;
+        SENSOR_SNAPSHOT sensors;
+        recordSnapshot(tick, ultrasonic, &sensors);
+
+        auto begin = std::chrono::steady_clock::now();
+        if(record.type == RECORD_Start) {
+            control.init(record.start.course, record.start.maxSpeed, sensors);
+            started = true;
+            firstTime = tick.time;
+        }
+        else {
+            control.update(sensors);
+            ticks++;
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        updateTime += elapsed;
+        maxUpdateTime = (elapsed > maxUpdateTime) ? elapsed : maxUpdateTime;
+        lastTime = tick.time;
+
+        if(tick.dropped != dropped) {
+            fprintf(stderr, "%10.3f s  %u records were dropped on the robot, the replay may diverge\n", tick.time / 1000.0, tick.dropped - dropped);
+            dropped = tick.dropped;
+        }
+        if((control.commands.motor != tick.motor) || (control.commands.steering != tick.steering)) {
+            if(verbose || (mismatches == 0)) {
+                fprintf(stderr, "%10.3f s  recorded motor %d steering %d, replayed motor %d steering %d\n", tick.time / 1000.0, tick.motor, tick.steering, control.commands.motor, control.commands.steering);
+            }
+            mismatches++;
+        }
+        if(csv != NULL) {
+            fprintf(csv, "%u,%d,%d,%d,%d,%u,%u,%u\n", tick.time, tick.motor, tick.steering, control.commands.motor, control.commands.steering, control.driveState.direction, control.driveState.state, control.curveCount);
+        }
+    }
+
+    double duration = (lastTime - firstTime) / 1000.0;
+    printf("%u ticks over %.1f s, %u mismatches, %u broken frames\n", ticks, duration, mismatches, broken);
+    if(ticks > 0) {
+        printf("update %.2f us average, %.2f us max, %.0fx real time\n", (updateTime / ticks) * 1e6, maxUpdateTime * 1e6, (updateTime > 0) ? duration / updateTime : 0);
+    }
+    if(csv != NULL) fclose(csv);
+    fclose(input);
+    return (mismatches == 0) ? 0 : 2;
+}
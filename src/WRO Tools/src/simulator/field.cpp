@@ -0,0 +1,168 @@
+#include "field.h"
+#include <math.h>
+#include "drive_control.h"
+
+// traffic sign marks along the straight sections, each on an outer and an inner lane
+static const float pillarPositions[] = { 1000, 1500, 2000 };
+
+// inner wall corners in clockwise driving order (bottom left first) and the direction of the section left there
+static const uint8_t cornerX[] = { 0, 0, 2, 2 };
+static const uint8_t cornerY[] = { 3, 1, 1, 3 };
+static const float cornerAngles[] = { M_PI / 2, M_PI, 3 * M_PI / 2, 0 };
+
+// distance from a point inside the outer walls to them along a direction
+static float outerWallDistance(float x, float y, float angle) {
+    float dx = cosf(angle);
+    float dy = sinf(angle);
+    float tx = (fabsf(dx) < 1e-6f) ? INFINITY : (((dx > 0) ? FIELD_SIZE - x : -x) / dx);
+    float ty = (fabsf(dy) < 1e-6f) ? INFINITY : (((dy > 0) ? FIELD_SIZE - y : -y) / dy);
+    return fminf(tx, ty);
+}
+
+void FIELD::generate(uint8_t course, std::mt19937& random) {
+    std::uniform_int_distribution<int> coin(0, 1);
+    for(uint8_t i = 0; i < 4; i++) {
+        corridor[i] = ((course == StarterCourse) && coin(random)) ? FIELD_NARROW_CORRIDOR : FIELD_WIDE_CORRIDOR;
+    }
+    inner[0] = corridor[Section_Left];
+    inner[1] = corridor[Section_Top];
+    inner[2] = FIELD_SIZE - corridor[Section_Right];
+    inner[3] = FIELD_SIZE - corridor[Section_Bottom];
+
+    walls[0] = { 0, 0, FIELD_SIZE, 0 };
+    walls[1] = { FIELD_SIZE, 0, FIELD_SIZE, FIELD_SIZE };
+    walls[2] = { FIELD_SIZE, FIELD_SIZE, 0, FIELD_SIZE };
+    walls[3] = { 0, FIELD_SIZE, 0, 0 };
+    walls[4] = { inner[0], inner[1], inner[2], inner[1] };
+    walls[5] = { inner[2], inner[1], inner[2], inner[3] };
+    walls[6] = { inner[2], inner[3], inner[0], inner[3] };
+    walls[7] = { inner[0], inner[3], inner[0], inner[1] };
+
+    // the orange and the blue line of a corner run from the inner wall corner to the outer wall
+    for(uint8_t i = 0; i < 4; i++) {
+        float x = inner[cornerX[i]];
+        float y = inner[cornerY[i]];
+        for(uint8_t j = 0; j < 2; j++) {
+            float angle = cornerAngles[i] + (j + 1) * FIELD_LINE_ANGLE;
+            float length = outerWallDistance(x, y, angle);
+            lines[2 * i + j] = { x, y, x + length * cosf(angle), y + length * sinf(angle), (uint8_t)((j == 0) ? Line_Orange : Line_Blue) };
+        }
+    }
+
+    pillarCount = 0;
+    if(course != ObstacleCourse) return;
+    for(uint8_t i = 0; i < 4; i++) {
+        uint8_t count = 1 + coin(random);
+        for(uint8_t j = 0; j < count; j++) {
+            // two pillars take the outer marks
+            float position = (count == 2) ? pillarPositions[2 * j] : pillarPositions[std::uniform_int_distribution<int>(0, 2)(random)];
+            FIELD_PILLAR& pillar = pillars[pillarCount++];
+            pillar.color = coin(random);
+            pillar.section = i;
+            pillar.lane = coin(random);
+            float offset = (pillar.lane == Lane_Outer) ? FIELD_LANE_OFFSET : corridor[i] - FIELD_LANE_OFFSET;
+            switch(i) {
+                case Section_Bottom:    pillar.x = position;                pillar.y = FIELD_SIZE - offset;     break;
+                case Section_Right:     pillar.x = FIELD_SIZE - offset;     pillar.y = position;                break;
+                case Section_Top:       pillar.x = position;                pillar.y = offset;                  break;
+                default:                pillar.x = offset;                  pillar.y = position;                break;
+            }
+        }
+    }
+}
+
+// the start zone is the straight part of the bottom section and the driving direction is drawn,
+// the team places the car beside the first pillar ahead on its side, the control only evades once it knows the driving direction
+void FIELD::startPose(std::mt19937& random, float halfLength, float halfWidth, float* x, float* y, float* theta) const {
+    std::uniform_real_distribution<float> along(FIELD_CORNER_SIZE + halfLength, FIELD_SIZE - FIELD_CORNER_SIZE - halfLength);
+    std::uniform_real_distribution<float> across(inner[3] + halfWidth + FIELD_START_MARGIN, FIELD_SIZE - halfWidth - FIELD_START_MARGIN);
+    std::uniform_real_distribution<float> skew(-0.03, 0.03);
+    *theta = ((random() & 1) ? M_PI : 0) + skew(random);
+    float heading = (*theta > M_PI / 2) ? -1 : 1;
+    for(uint16_t attempt = 0; ; attempt++) {
+        *x = along(random);
+        *y = across(random);
+        bool clear = true;
+        const FIELD_PILLAR* first = NULL;
+        float firstForward = FIELD_SIZE;
+        for(uint8_t i = 0; i < pillarCount; i++) {
+            const FIELD_PILLAR& pillar = pillars[i];
+            float forward = heading * (pillar.x - *x);
+            float right = heading * (pillar.y - *y);
+            if((fabsf(forward) < halfLength + FIELD_PILLAR_RADIUS + FIELD_START_MARGIN) && (fabsf(right) < halfWidth + FIELD_PILLAR_RADIUS + FIELD_START_MARGIN)) {
+                clear = false;
+            }
+            if((pillar.section == Section_Bottom) && (forward > -halfLength) && (forward < firstForward)) {
+                first = &pillar;
+                firstForward = forward;
+            }
+        }
+        // red pillars stay left of the car, green ones right, a field without such a place only keeps the car clear
+        if(clear && (first != NULL) && (attempt < FIELD_START_ATTEMPTS)) {
+            float right = heading * (first->y - *y);
+            clear = ((first->color == 1) ? -right : right) >= halfWidth + FIELD_PILLAR_RADIUS;
+        }
+        if(clear) return;
+    }
+}
+
+float FIELD::raycast(float x, float y, float angle, float range, float* incidence, bool pillars) const {
+    float dx = cosf(angle);
+    float dy = sinf(angle);
+    float nearest = range;
+    float nearestIncidence = 0;
+    bool hit = false;
+    for(uint8_t i = 0; i < FIELD_WALL_COUNT; i++) {
+        const FIELD_WALL& wall = walls[i];
+        float wx = wall.x2 - wall.x1;
+        float wy = wall.y2 - wall.y1;
+        float denominator = dx * wy - dy * wx;
+        if(fabsf(denominator) < 1e-6f) continue;
+        float t = ((wall.x1 - x) * wy - (wall.y1 - y) * wx) / denominator;
+        float u = ((wall.x1 - x) * dy - (wall.y1 - y) * dx) / denominator;
+        if((t <= 0) || (t >= nearest) || (u < 0) || (u > 1)) continue;
+        nearest = t;
+        // angle between the ray and the wall normal
+        nearestIncidence = acosf(fminf(1, fabsf(denominator) / sqrtf(wx * wx + wy * wy)));
+        hit = true;
+    }
+    for(uint8_t i = 0; pillars && (i < pillarCount); i++) {
+        float px = this->pillars[i].x - x;
+        float py = this->pillars[i].y - y;
+        float along = px * dx + py * dy;
+        float across = px * dy - py * dx;
+        if((along <= 0) || (fabsf(across) > FIELD_PILLAR_RADIUS)) continue;
+        float t = along - sqrtf(FIELD_PILLAR_RADIUS * FIELD_PILLAR_RADIUS - across * across);
+        if((t <= 0) || (t >= nearest)) continue;
+        nearest = t;
+        nearestIncidence = asinf(fabsf(across) / FIELD_PILLAR_RADIUS);
+        hit = true;
+    }
+    if(incidence != NULL) {
+        *incidence = nearestIncidence;
+    }
+    return hit ? nearest : 0;
+}
+
+bool FIELD::inside(float x, float y) const {
+    if((x <= 0) || (y <= 0) || (x >= FIELD_SIZE) || (y >= FIELD_SIZE)) return false;
+    return (x < inner[0]) || (y < inner[1]) || (x > inner[2]) || (y > inner[3]);
+}
+
+bool FIELD::visible(float x1, float y1, float x2, float y2) const {
+    float distance = hypotf(x2 - x1, y2 - y1);
+    float wall = raycast(x1, y1, atan2f(y2 - y1, x2 - x1), distance, NULL, false);
+    return wall == 0;
+}
+
+uint8_t FIELD::section(float x, float y) const {
+    bool left = x < inner[0];
+    bool right = x > inner[2];
+    bool top = y < inner[1];
+    bool bottom = y > inner[3];
+    if((left || right) && (top || bottom)) return Section_Corner;
+    if(bottom) return Section_Bottom;
+    if(right) return Section_Right;
+    if(top) return Section_Top;
+    return Section_Left;
+}
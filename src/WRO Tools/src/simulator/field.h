@@ -0,0 +1,84 @@
+#ifndef FIELD_H
+#define FIELD_H
+
+/**
+ * Simulated WRO Future Engineers field
+ * by TerraForce
+*/
+
+#include <stdint.h>
+#include <random>
+
+#define FIELD_SIZE              3000    // outer wall square in mm
+#define FIELD_CORNER_SIZE       1000    // corner squares of the mat, the straight sections lie between them in mm
+#define FIELD_WIDE_CORRIDOR     1000    // corridor width between outer and inner wall in mm
+#define FIELD_NARROW_CORRIDOR   600     // randomised corridor width of the starter course in mm
+#define FIELD_WALL_COUNT        8
+#define FIELD_MAX_PILLARS       8
+#define FIELD_PILLAR_RADIUS     30      // 50 mm square pillars modelled as circles in mm
+#define FIELD_LANE_OFFSET       400     // traffic sign marks of the outer and the inner lane from their wall in mm
+#define FIELD_LINE_COUNT        8
+#define FIELD_LINE_ANGLE        0.5236  // corner lines fan out from the inner wall corner 30 and 60 degrees into the corner in rad
+#define FIELD_START_MARGIN      100     // the car is placed at least this far from walls and pillars in mm
+#define FIELD_START_ATTEMPTS    1000    // start poses drawn before the side of the first pillar is given up
+
+enum FieldSections {
+    Section_Bottom,
+    Section_Right,
+    Section_Top,
+    Section_Left,
+    Section_Corner
+};
+
+enum FieldLanes {
+    Lane_Outer,
+    Lane_Inner
+};
+
+enum FieldLineColors {
+    Line_Orange,    // crossed first when driving clockwise
+    Line_Blue
+};
+
+// field coordinates: origin in the top left corner, x to the right, y down, angles clockwise from the x axis
+struct FIELD_WALL {
+    float x1, y1;
+    float x2, y2;
+};
+
+struct FIELD_PILLAR {
+    float x, y;
+    uint8_t color;      // 0: green (passed left), 1: red (passed right)
+    uint8_t section;
+    uint8_t lane;
+};
+
+struct FIELD_LINE {
+    float x1, y1;       // inner wall corner
+    float x2, y2;       // outer wall
+    uint8_t color;
+};
+
+class FIELD {
+    public:
+        void generate(uint8_t course, std::mt19937& random);
+
+        // random pose in the start zone of the bottom section, the car body keeps FIELD_START_MARGIN to walls and pillars
+        // and the first pillar ahead is on its side
+        void startPose(std::mt19937& random, float halfLength, float halfWidth, float* x, float* y, float* theta) const;
+
+        // distance along the ray to the nearest wall or pillar, 0 if nothing is hit within range
+        float raycast(float x, float y, float angle, float range, float* incidence = NULL, bool pillars = true) const;
+        bool inside(float x, float y) const;
+        bool visible(float x1, float y1, float x2, float y2) const;
+        uint8_t section(float x, float y) const;
+
+        FIELD_WALL walls[FIELD_WALL_COUNT] = {};
+        FIELD_PILLAR pillars[FIELD_MAX_PILLARS] = {};
+        uint8_t pillarCount = 0;
+        FIELD_LINE lines[FIELD_LINE_COUNT] = {};
+        float corridor[4] = {};     // corridor width per section in mm
+        float inner[4] = {};        // inner wall square: left, top, right, bottom in mm
+};
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * Field simulator
+ * by TerraForce
+ *
+ * Drives the drive control of WRO Main around randomised WRO Future Engineers fields
+ * with simulated sensors and reports lap times and failures. Runs are deterministic
+ * per seed and spread over all cores, run i uses seed <seed> + i.
+ * Usage: simulator [--course starter|obstacle] [--runs <n>] [--seed <s>] [--threads <n>]
+ *                  [--speed <max speed>] [--verbose] [--csv <file>] [--record <file>]
+ *
+ * --csv and --record need --runs 1, the recording can be checked with the replay.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "simulation.h"
+
+static double percentile(std::vector<double>& values, double share) {
+    if(values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(share * (values.size() - 1))];
+}
+
+int main(int argc, char** argv) {
+    uint8_t course = StarterCourse;
+    uint32_t runs = 100;
+    uint32_t seed = 1;
+    uint32_t threads = std::thread::hardware_concurrency();
+    uint8_t maxSpeed = 11;
+    bool verbose = false;
+    const char* csvPath = NULL;
+    const char* recordingPath = NULL;
+    bool usage = false;
+    for(int i = 1; i < argc; i++) {
+        bool value = i + 1 < argc;
+        if(strcmp(argv[i], "--verbose") == 0) verbose = true;
+        else if((strcmp(argv[i], "--course") == 0) && value) course = (strcmp(argv[++i], "obstacle") == 0) ? ObstacleCourse : StarterCourse;
+        else if((strcmp(argv[i], "--runs") == 0) && value) runs = strtoul(argv[++i], NULL, 10);
+        else if((strcmp(argv[i], "--seed") == 0) && value) seed = strtoul(argv[++i], NULL, 10);
+        else if((strcmp(argv[i], "--threads") == 0) && value) threads = strtoul(argv[++i], NULL, 10);
+        else if((strcmp(argv[i], "--speed") == 0) && value) maxSpeed = (uint8_t)strtoul(argv[++i], NULL, 10);
+        else if((strcmp(argv[i], "--csv") == 0) && value) csvPath = argv[++i];
+        else if((strcmp(argv[i], "--record") == 0) && value) recordingPath = argv[++i];
+        else usage = true;
+    }
+    if(usage || (runs == 0) || (((csvPath != NULL) || (recordingPath != NULL)) && (runs != 1))) {
+        fprintf(stderr, "Usage: simulator [--course starter|obstacle] [--runs <n>] [--seed <s>] [--threads <n>]\n"
+                        "                 [--speed <max speed>] [--verbose] [--csv <file>] [--record <file>]\n");
+        return 1;
+    }
+    threads = std::max(1U, std::min(threads, runs));
+
+    std::vector<SIMULATION_RESULT> results(runs);
+    std::atomic<uint32_t> nextRun(0);
+    auto begin = std::chrono::steady_clock::now();
+    if(runs == 1) {
+        SIMULATION simulation;
+        simulation.csv = csvPath ? fopen(csvPath, "w") : NULL;
+        simulation.recording = recordingPath ? fopen(recordingPath, "wb") : NULL;
+        results[0] = simulation.run(seed, course, maxSpeed);
+        if(simulation.csv != NULL) fclose(simulation.csv);
+        if(simulation.recording != NULL) fclose(simulation.recording);
+    }
+    else {
+        // results are stored by run index, the report does not depend on the thread count
+        std::vector<std::thread> workers;
+        for(uint32_t i = 0; i < threads; i++) {
+            workers.emplace_back([&]() {
+                SIMULATION simulation;
+                uint32_t run;
+                while((run = nextRun++) < runs) {
+                    results[run] = simulation.run(seed + run, course, maxSpeed);
+                }
+            });
+        }
+        for(std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    uint32_t outcomes[Run_Outcomes] = {};
+    std::vector<double> totals;
+    std::vector<double> laps;
+    double simulated = 0;
+    double odometryError = 0;
+    for(const SIMULATION_RESULT& result : results) {
+        outcomes[result.outcome]++;
+        simulated += result.time / 1000.0;
+        if(verbose || (runs == 1)) {
+            printf("seed %u: %-16s %6.1f s, %2u curves, laps", result.seed, simulationOutcomeNames[result.outcome], result.time / 1000.0, result.curveCount);
+            for(uint8_t i = 0; i < SIMULATION_LAPS; i++) {
+                printf(" %5.1f", result.laps[i] / 1000.0);
+            }
+            printf(", odometry error %.0f mm\n", result.odometryError);
+        }
+        if(result.outcome != Run_Finished) continue;
+        totals.push_back(result.time / 1000.0);
+        for(uint8_t i = 0; i < SIMULATION_LAPS; i++) {
+            laps.push_back(result.laps[i] / 1000.0);
+        }
+        odometryError += result.odometryError;
+    }
+
+    printf("%u runs of the %s course at max speed %u\n", runs, (course == ObstacleCourse) ? "obstacle" : "starter", maxSpeed);
+    for(uint8_t i = 0; i < Run_Outcomes; i++) {
+        printf("%-16s %6u  %5.1f %%\n", simulationOutcomeNames[i], outcomes[i], 100.0 * outcomes[i] / runs);
+    }
+    if(!totals.empty()) {
+        printf("run time         %.1f / %.1f / %.1f s min / median / 95th percentile\n", percentile(totals, 0), percentile(totals, 0.5), percentile(totals, 0.95));
+        printf("lap time         %.1f / %.1f / %.1f s min / median / 95th percentile\n", percentile(laps, 0), percentile(laps, 0.5), percentile(laps, 0.95));
+        printf("odometry error   %.0f mm mean at the stop\n", odometryError / totals.size());
+    }
+    if(!verbose && (runs > 1) && (outcomes[Run_Finished] < runs)) {
+        printf("failed seeds    ");
+        uint8_t listed = 0;
+        for(uint32_t i = 0; (i < runs) && (listed < 10); i++) {
+            if(results[i].outcome == Run_Finished) continue;
+            printf(" %u", results[i].seed);
+            listed++;
+        }
+        printf("%s\n", (runs - outcomes[Run_Finished] > listed) ? " ..." : "");
+    }
+    printf("%.1f s simulated in %.1f s on %u threads, %.0fx real time\n", simulated, elapsed, threads, (elapsed > 0) ? simulated / elapsed : 0);
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include "robot.h"
+#include <math.h>
+
+#define VOLTAGE_PER_ADC_STEP    0.00301513671875    // WRO Servo ADC as read by WRO Main
+
+struct ROBOT_SENSOR {
+    float forward;  // mm
+    float right;    // mm
+    float angle;    // rad relative to the heading
+};
+
+// mounting positions in the order of UltraSonicPositions
+static const ROBOT_SENSOR sensors[] = {
+    { STEERING_SENSOR_SPACING / 2, -DRIVE_SIDE_SENSOR_OFFSET, -M_PI / 2 },
+    { DRIVE_FRONT_SENSOR_OFFSET, 0, 0 },
+    { STEERING_SENSOR_SPACING / 2, DRIVE_SIDE_SENSOR_OFFSET, M_PI / 2 },
+    { -STEERING_SENSOR_SPACING / 2, -DRIVE_SIDE_SENSOR_OFFSET, -M_PI / 2 },
+    { -DRIVE_FRONT_SENSOR_OFFSET, 0, M_PI },
+    { -STEERING_SENSOR_SPACING / 2, DRIVE_SIDE_SENSOR_OFFSET, M_PI / 2 }
+};
+
+static const float coneRays[] = { -1, -0.5, 0, 0.5, 1 };
+
+void ROBOT::init(float x, float y, float theta, const ROBOT_VARIATION& variation, std::mt19937* random) {
+    this->x = x;
+    this->y = y;
+    this->theta = theta;
+    speed = 0;
+    wheelAngle = variation.steeringOffset;
+    travelled = 0;
+    _variation = variation;
+    _random = random;
+    _startTheta = theta;
+    _motor = 0;
+    _steeringAngle = 0;
+    _nextFrame = 0;
+}
+
+// kinematic bicycle model around the car center
+void ROBOT::update(uint32_t time, float dt, int8_t motor, int16_t steeringAngle) {
+    if(time >= _nextFrame) {
+        _motor += fmaxf(-ROBOT_MOTOR_SLEW, fminf(ROBOT_MOTOR_SLEW, motor - _motor));
+        _steeringAngle = steeringAngle;
+        _nextFrame = time + ROBOT_SERVO_FRAME;
+    }
+
+    float targetAngle = _variation.steeringOffset + (_steeringAngle / (15.0f * DRIVE_STEERING_STEP)) * ROBOT_MAX_STEERING_ANGLE;
+    float maxChange = ROBOT_STEERING_RATE * dt;
+    wheelAngle += fmaxf(-maxChange, fminf(maxChange, targetAngle - wheelAngle));
+
+    float targetSpeed = DRIVE_FEED_FORWARD * _motor * battery() / 1000.0f * _variation.motorGain;
+    speed += (targetSpeed - speed) * fminf(1, dt / ROBOT_MOTOR_TIME_CONSTANT);
+
+    float slip = atanf(tanf(wheelAngle) / 2);
+    x += speed * cosf(theta + slip) * dt;
+    y += speed * sinf(theta + slip) * dt;
+    theta += speed * cosf(slip) * tanf(wheelAngle) / ROBOT_WHEELBASE * dt;
+    travelled += fabsf(speed) * dt;
+}
+
+void ROBOT::toRobot(float x, float y, float* forward, float* right) const {
+    float dx = x - this->x;
+    float dy = y - this->y;
+    *forward = dx * cosf(theta) + dy * sinf(theta);
+    *right = -dx * sinf(theta) + dy * cosf(theta);
+}
+
+bool ROBOT::collides(const FIELD& field, bool* pillar) const {
+    *pillar = false;
+    float c = cosf(theta);
+    float s = sinf(theta);
+    for(int8_t i = -1; i <= 1; i++) {
+        for(int8_t j = -1; j <= 1; j++) {
+            if((i == 0) && (j == 0)) continue;
+            float forward = i * ROBOT_HALF_LENGTH;
+            float right = j * ROBOT_HALF_WIDTH;
+            if(!field.inside(x + forward * c - right * s, y + forward * s + right * c)) return true;
+        }
+    }
+    // corners of the inner walls can reach into the sides of the body
+    for(uint8_t i = 0; i < 4; i++) {
+        float forward, right;
+        toRobot(field.inner[(i & 1) ? 2 : 0], field.inner[(i & 2) ? 3 : 1], &forward, &right);
+        if((fabsf(forward) < ROBOT_HALF_LENGTH) && (fabsf(right) < ROBOT_HALF_WIDTH)) return true;
+    }
+    for(uint8_t i = 0; i < field.pillarCount; i++) {
+        float forward, right;
+        toRobot(field.pillars[i].x, field.pillars[i].y, &forward, &right);
+        float dx = fmaxf(0, fabsf(forward) - ROBOT_HALF_LENGTH);
+        float dy = fmaxf(0, fabsf(right) - ROBOT_HALF_WIDTH);
+        if(dx * dx + dy * dy < FIELD_PILLAR_RADIUS * FIELD_PILLAR_RADIUS) {
+            *pillar = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// the nearest echo inside the sound cone, walls hit at a flat angle reflect the sound away
+bool ROBOT::ultrasonic(const FIELD& field, uint8_t sensor, uint16_t* distance) {
+    const ROBOT_SENSOR& mount = sensors[sensor];
+    float c = cosf(theta);
+    float s = sinf(theta);
+    float sx = x + mount.forward * c - mount.right * s;
+    float sy = y + mount.forward * s + mount.right * c;
+    float nearest = 0;
+    for(uint8_t i = 0; i < sizeof(coneRays) / sizeof(float); i++) {
+        float incidence;
+        float hit = field.raycast(sx, sy, theta + mount.angle + coneRays[i] * ROBOT_ULTRASONIC_CONE, ROBOT_ULTRASONIC_RANGE, &incidence);
+        if((hit > 0) && (incidence < ROBOT_ULTRASONIC_REFLECTION) && ((nearest == 0) || (hit < nearest))) {
+            nearest = hit;
+        }
+    }
+
+    std::uniform_real_distribution<float> uniform(0, 1);
+    float chance = uniform(*_random);
+    if((nearest == 0) || (chance < 0.02f)) {
+        *distance = 0;
+        return false;
+    }
+    if(chance < 0.03f) {
+        nearest = uniform(*_random) * ROBOT_ULTRASONIC_RANGE;
+    }
+    nearest += std::normal_distribution<float>(0, 3 + 0.01f * nearest)(*_random);
+    *distance = (uint16_t)fmaxf(0, nearest);
+    return true;
+}
+
+int32_t ROBOT::rotation(uint32_t time) {
+    float rotation = (theta - _startTheta) * (1800 / M_PI) + _variation.gyroDrift * time / 1000.0f;
+    return (int32_t)lroundf(rotation + std::normal_distribution<float>(0, 1)(*_random));
+}
+
+// WRO Camera reports the lowest coloured pixel, which is the nearest pillar in view
+SENSOR_SNAPSHOT::OBJECT_DATA ROBOT::object(const FIELD& field) const {
+    SENSOR_SNAPSHOT::OBJECT_DATA object = {};
+    float nearest = ROBOT_CAMERA_RANGE;
+    float cx = x + ROBOT_CAMERA_OFFSET * cosf(theta);
+    float cy = y + ROBOT_CAMERA_OFFSET * sinf(theta);
+    for(uint8_t i = 0; i < field.pillarCount; i++) {
+        const FIELD_PILLAR& pillar = field.pillars[i];
+        float forward, right;
+        toRobot(pillar.x, pillar.y, &forward, &right);
+        forward -= ROBOT_CAMERA_OFFSET;
+        float distance = hypotf(forward, right);
+        float bearing = atan2f(right, forward);
+        if((distance >= nearest) || (fabsf(bearing) > ROBOT_CAMERA_FOV) || !field.visible(cx, cy, pillar.x, pillar.y)) continue;
+        nearest = distance;
+        object.available = 1;
+        object.color = pillar.color;
+        object.direction = bearing > 0;
+        object.angle = (uint8_t)(fabsf(bearing) / ROBOT_CAMERA_FOV * 0x1F);
+    }
+    return object;
+}
+
+int32_t ROBOT::motorTurns() const {
+    return (int32_t)(travelled / (DRIVE_MM_PER_MOTOR_TICK * _variation.encoderScale));
+}
+
+// WRO Servo reports 0 below one encoder tick per ROBOT_ENCODER_TIMEOUT
+int16_t ROBOT::motorRpm() const {
+    float rpm = fabsf(speed) * 60 / (SPEED_TICKS_PER_TURN * DRIVE_MM_PER_MOTOR_TICK * _variation.encoderScale);
+    return (rpm * SPEED_TICKS_PER_TURN * ROBOT_ENCODER_TIMEOUT < 60000) ? 0 : (int16_t)rpm;
+}
+
+// the battery sags under load
+uint16_t ROBOT::battery() const {
+    float voltage = _variation.voltage - 0.3f * fabsf(_motor) / 15;
+    return (uint16_t)(lroundf(voltage / VOLTAGE_PER_ADC_STEP) * VOLTAGE_PER_ADC_STEP * 1000);
+}
@@ -0,0 +1,80 @@
+#ifndef ROBOT_H
+#define ROBOT_H
+
+/**
+ * Simulated WRO car: kinematics and sensor models
+ * by TerraForce
+*/
+
+#include <stdint.h>
+#include <random>
+#include "field.h"
+#include "drive_control.h"
+
+// chassis
+#define ROBOT_HALF_LENGTH           150     // mm
+#define ROBOT_HALF_WIDTH            90      // mm
+#define ROBOT_WHEELBASE             180     // mm
+#define ROBOT_MAX_STEERING_ANGLE    0.52    // front wheel angle at steering command 15 in rad
+#define ROBOT_STEERING_RATE         3.0     // front wheel angle rate of the steering servo in rad/s
+#define ROBOT_MOTOR_TIME_CONSTANT   0.2     // s
+#define ROBOT_SERVO_FRAME           20      // the servo board latches new commands once per pulse frame in ms
+#define ROBOT_MOTOR_SLEW            1.5     // motor command steps per frame of the WRO Servo motion profile
+#define ROBOT_ENCODER_TIMEOUT       100     // WRO Servo reports no rpm without an encoder edge for this long in ms
+
+// sensors
+#define ROBOT_ULTRASONIC_RANGE      3500    // mm
+#define ROBOT_ULTRASONIC_CONE       0.21    // half opening angle of the sound cone in rad
+#define ROBOT_ULTRASONIC_REFLECTION 0.87    // walls hit at a larger incidence reflect the echo away in rad
+#define ROBOT_ULTRASONIC_TIMEOUT    38      // echo pulse of a sensor without echo in ms
+#define ROBOT_CAMERA_OFFSET         100     // camera in front of the car center in mm
+#define ROBOT_CAMERA_FOV            0.52    // half horizontal field of view in rad
+#define ROBOT_CAMERA_RANGE          1500    // mm
+#define ROBOT_CAMERA_PERIOD         100     // object update period of WRO Camera in ms
+#define ROBOT_GYRO_PERIOD           30      // rotation update period of WRO Camera in ms
+
+// per run deviations of the real car from the calibration of WRO Main
+struct ROBOT_VARIATION {
+    float motorGain;        // wheel speed relative to DRIVE_FEED_FORWARD
+    float encoderScale;     // travel per encoder tick relative to DRIVE_MM_PER_MOTOR_TICK
+    float steeringOffset;   // front wheel angle at steering command 0 in rad
+    float gyroDrift;        // 1/10 degrees per s
+    float voltage;          // charged battery in V
+};
+
+class ROBOT {
+    public:
+        void init(float x, float y, float theta, const ROBOT_VARIATION& variation, std::mt19937* random);
+        void update(uint32_t time, float dt, int8_t motor, int16_t steeringAngle);
+
+        // the body touches a wall or a pillar
+        bool collides(const FIELD& field, bool* pillar) const;
+
+        // positions relative to the car: forward and to the right in mm
+        void toRobot(float x, float y, float* forward, float* right) const;
+
+        // sensor readings as WRO Main receives them
+        bool ultrasonic(const FIELD& field, uint8_t sensor, uint16_t* distance);
+        int32_t rotation(uint32_t time);
+        SENSOR_SNAPSHOT::OBJECT_DATA object(const FIELD& field) const;
+        int32_t motorTurns() const;
+        int16_t motorRpm() const;
+        uint16_t battery() const;
+
+        float x = 0;            // mm
+        float y = 0;            // mm
+        float theta = 0;        // rad, clockwise from the x axis
+        float speed = 0;        // mm/s
+        float wheelAngle = 0;   // rad, positive to the right
+        float travelled = 0;    // absolute travel in mm
+
+    private:
+        ROBOT_VARIATION _variation = {};
+        std::mt19937* _random = NULL;
+        float _startTheta = 0;
+        float _motor = 0;
+        int16_t _steeringAngle = 0;
+        uint32_t _nextFrame = 0;
+};
+
+#endif
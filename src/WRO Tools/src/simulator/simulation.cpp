@@ -0,0 +1,209 @@
+#include "simulation.h"
+#include <math.h>
+
+const char* const simulationOutcomeNames[Run_Outcomes] = { "finished", "wall collision", "pillar collision", "pillar side", "stop position", "timeout" };
+
+// firing order of the ultrasonic thread of WRO Main
+static const uint8_t ultrasonicProcess[] = { US_LeftFront, US_CenterFront, US_RightFront, US_LeftBack, Variable, US_RightBack };
+
+SIMULATION_RESULT SIMULATION::run(uint32_t seed, uint8_t course, uint8_t maxSpeed) {
+    SIMULATION_RESULT result = {};
+    result.seed = seed;
+    _random.seed(seed);
+    _field.generate(course, _random);
+
+    std::uniform_real_distribution<float> uniform(-1, 1);
+    ROBOT_VARIATION variation;
+    variation.motorGain = 1 + 0.15f * uniform(_random);
+    variation.encoderScale = 1 + 0.03f * uniform(_random);
+    variation.steeringOffset = 0.02f * uniform(_random);
+    variation.gyroDrift = 2 * uniform(_random);
+    variation.voltage = 8.0f + 0.4f * uniform(_random);
+    float startX, startY, startTheta;
+    _field.startPose(_random, ROBOT_HALF_LENGTH, ROBOT_HALF_WIDTH, &startX, &startY, &startTheta);
+    _robot.init(startX, startY, startTheta, variation, &_random);
+
+    _ultrasonic.init(SIMULATION_FILTER_SIZE, SIMULATION_OUTLIER, SIMULATION_MAX_AGE);
+    _control = DRIVE_CONTROL();
+    _started = false;
+    _rotation = 0;
+    _object = {};
+    _rotationTime = 0;
+    _objectTime = 0;
+    _motorTurns = 0;
+    _motorRpm = 0;
+    _battery = 0;
+    _nextUltrasonic = 0;
+    _ultrasonicTime = 0;
+    for(uint8_t i = 0; i < _field.pillarCount; i++) {
+        float right;
+        _robot.toRobot(_field.pillars[i].x, _field.pillars[i].y, &_pillarForward[i], &right);
+    }
+
+    RECORD config = { RECORD_Config };
+    config.config = { RECORD_VERSION, SIMULATION_FILTER_SIZE, SIMULATION_OUTLIER, SIMULATION_MAX_AGE, 1000 / SIMULATION_CONTROL_PERIOD };
+    record(config);
+    if(csv != NULL) {
+        fprintf(csv, "time,x,y,theta,speed,motor,steering,direction,state,curve_count,odometry_x,odometry_y\n");
+    }
+
+    int8_t motor = 0;
+    int8_t steering = 0;
+    int16_t steeringAngle = 0;
+    uint32_t startTime = 0;
+    uint32_t lapStart = 0;
+    uint8_t laps = 0;
+    uint32_t controlTick = 0;
+    float lastAngle = atan2f(startY - FIELD_SIZE / 2, startX - FIELD_SIZE / 2);
+    float progress = 0;
+    result.outcome = Run_Timeout;
+
+    for(uint32_t time = 1; ; time++) {
+        _robot.update(time, 0.001f, motor, steeringAngle);
+        if(time >= _ultrasonicTime) {
+            fireUltrasonic(time);
+        }
+        if(time % ROBOT_GYRO_PERIOD == 0) {
+            _rotation = _robot.rotation(time);
+            _rotationTime = time;
+        }
+        if(time % ROBOT_CAMERA_PERIOD == 0) {
+            _object = _robot.object(_field);
+            _objectTime = time;
+        }
+        if((time % SIMULATION_CONTROL_PERIOD != 0) || (time < SIMULATION_STARTUP)) continue;
+
+        SENSOR_SNAPSHOT sensors;
+        if(!_started) {
+            _motorTurns = _robot.motorTurns();
+            _motorRpm = _robot.motorRpm();
+            _battery = _robot.battery();
+            sensors = snapshot(time);
+            _control.init(course, maxSpeed, sensors);
+            _started = true;
+            startTime = time;
+            lapStart = time;
+        }
+        else {
+            sensors = snapshot(time);
+            _control.update(sensors);
+        }
+        // the power board answers after the snapshot of the polling tick
+        _motorTurns = _robot.motorTurns();
+        _motorRpm = _robot.motorRpm();
+        if(++controlTick % SIMULATION_POWER_DIVIDER == 0) {
+            _battery = _robot.battery();
+        }
+        motor = _control.commands.motor;
+        steering = _control.commands.steering;
+        steeringAngle = _control.commands.steeringAngle;
+
+        if(recording != NULL) {
+            RECORD tick = { (uint8_t)((time == startTime) ? RECORD_Start : RECORD_Tick) };
+            RECORD_TICK& data = (time == startTime) ? tick.start.tick : tick.tick;
+            data = { sensors.time, sensors.rotation, recordObject(sensors.object), sensors.rotationAge, sensors.objectAge, sensors.motorTurns, sensors.motorRpm, sensors.battery, motor, steering, 0 };
+            if(time == startTime) {
+                tick.start.course = course;
+                tick.start.maxSpeed = maxSpeed;
+            }
+            record(tick);
+        }
+
+        // odometry pose in field coordinates
+        const ODOMETRY& odometry = _control.odometry;
+        float odometryX = startX + odometry.x * cosf(startTheta) - odometry.y * sinf(startTheta);
+        float odometryY = startY + odometry.x * sinf(startTheta) + odometry.y * cosf(startTheta);
+        if(csv != NULL) {
+            fprintf(csv, "%u,%.1f,%.1f,%.4f,%.1f,%d,%d,%u,%u,%u,%.1f,%.1f\n", time - startTime, _robot.x, _robot.y, _robot.theta, _robot.speed, motor, steering, _control.driveState.direction, _control.driveState.state, _control.curveCount, odometryX, odometryY);
+        }
+        result.time = time - startTime;
+        result.curveCount = _control.curveCount;
+        result.odometryError = hypotf(odometryX - _robot.x, odometryY - _robot.y);
+
+        bool pillar;
+        if(_robot.collides(_field, &pillar)) {
+            result.outcome = pillar ? Run_PillarCollision : Run_WallCollision;
+            break;
+        }
+        if(!checkPillars()) {
+            result.outcome = Run_PillarSide;
+            break;
+        }
+
+        // laps are counted by the angle around the field center
+        float angle = atan2f(_robot.y - FIELD_SIZE / 2, _robot.x - FIELD_SIZE / 2);
+        progress += remainderf(angle - lastAngle, 2 * M_PI);
+        lastAngle = angle;
+        if((laps < SIMULATION_LAPS) && (fabsf(progress) >= 2 * M_PI * (laps + 1))) {
+            result.laps[laps++] = time - lapStart;
+            lapStart = time;
+        }
+
+        if((_control.curveCount >= 12) && (_control.commands.velocity == 0) && (fabsf(_robot.speed) < 10)) {
+            if(laps < SIMULATION_LAPS) {
+                result.laps[laps++] = time - lapStart;
+            }
+            bool started = fabsf(progress) > 2 * M_PI * (SIMULATION_LAPS - 0.5f);
+            result.outcome = (started && (_field.section(_robot.x, _robot.y) == Section_Bottom)) ? Run_Finished : Run_StopPosition;
+            break;
+        }
+        if(time - startTime >= SIMULATION_TIME_LIMIT) break;
+    }
+    return result;
+}
+
+SENSOR_SNAPSHOT SIMULATION::snapshot(uint32_t time) {
+    RECORD_TICK tick = {};
+    tick.time = time;
+    tick.rotation = _rotation;
+    tick.object = recordObject(_object);
+    tick.rotationAge = (uint16_t)(time - _rotationTime);
+    tick.objectAge = (uint16_t)(time - _objectTime);
+    tick.motorTurns = _motorTurns;
+    tick.motorRpm = _motorRpm;
+    tick.battery = _battery;
+    SENSOR_SNAPSHOT sensors;
+    recordSnapshot(tick, _ultrasonic, &sensors);
+    return sensors;
+}
+
+// one sensor at a time: trigger, echo and the pause of the ultrasonic thread
+void SIMULATION::fireUltrasonic(uint32_t time) {
+    uint8_t sensor = nextSensor();
+    uint16_t distance;
+    bool valid = _robot.ultrasonic(_field, sensor, &distance);
+    _ultrasonic.add(sensor, distance, time, valid);
+    RECORD sample = { RECORD_Ultrasonic };
+    sample.ultrasonic = { time, sensor, distance, valid };
+    record(sample);
+    _ultrasonicTime = time + 1 + (valid ? (2 * distance) / 343 : ROBOT_ULTRASONIC_TIMEOUT) + SIMULATION_ULTRASONIC_DELAY;
+}
+
+uint8_t SIMULATION::nextSensor() {
+    uint8_t sensor = ultrasonicProcess[_nextUltrasonic];
+    _nextUltrasonic = (_nextUltrasonic + 1) % sizeof(ultrasonicProcess);
+    if(sensor != Variable) return sensor;
+    return (_control.outsideBorder == Left) ? US_RightFront : ((_control.outsideBorder == Right) ? US_LeftFront : US_CenterFront);
+}
+
+void SIMULATION::record(const RECORD& record) {
+    if(recording == NULL) return;
+    uint8_t frame[RECORD_MAX_FRAME];
+    fwrite(frame, 1, recordEncode(record, frame), recording);
+}
+
+// red pillars have to stay on the left of the car, green ones on the right,
+// a pillar only counts while the car drives along its section and not across it in a corner
+bool SIMULATION::checkPillars() {
+    bool alongX = fabsf(cosf(_robot.theta)) > fabsf(sinf(_robot.theta));
+    for(uint8_t i = 0; i < _field.pillarCount; i++) {
+        const FIELD_PILLAR& pillar = _field.pillars[i];
+        float forward, right;
+        _robot.toRobot(pillar.x, pillar.y, &forward, &right);
+        bool along = alongX == ((pillar.section == Section_Bottom) || (pillar.section == Section_Top));
+        bool passed = along && (_pillarForward[i] > 0) && (forward <= 0) && (fabsf(right) < _field.corridor[pillar.section]);
+        _pillarForward[i] = forward;
+        if(passed && ((pillar.color == 1) != (right < 0))) return false;
+    }
+    return true;
+}
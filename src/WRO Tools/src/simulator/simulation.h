@@ -0,0 +1,85 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+/**
+ * One simulated run of the drive control on a random field
+ * by TerraForce
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <random>
+#include "field.h"
+#include "robot.h"
+#include "drive_control.h"
+#include "recorder.h"
+#include "ultrasonic.h"
+
+// timing and filter parameters of WRO Main
+#define SIMULATION_FILTER_SIZE      3       // ultrasonic median window in samples
+#define SIMULATION_OUTLIER          150     // mm
+#define SIMULATION_MAX_AGE          250     // ms
+#define SIMULATION_CONTROL_PERIOD   5       // ms
+#define SIMULATION_POWER_DIVIDER    4       // encoders are read every control tick, the battery every 4th
+#define SIMULATION_ULTRASONIC_DELAY 30      // pause after each ultrasonic measurement in ms
+#define SIMULATION_STARTUP          1000    // sensors run before the start signal in ms
+#define SIMULATION_TIME_LIMIT       180000  // ms
+#define SIMULATION_LAPS             3
+
+enum SimulationOutcomes {
+    Run_Finished,
+    Run_WallCollision,
+    Run_PillarCollision,
+    Run_PillarSide,
+    Run_StopPosition,
+    Run_Timeout,
+    Run_Outcomes
+};
+
+extern const char* const simulationOutcomeNames[Run_Outcomes];
+
+struct SIMULATION_RESULT {
+    uint32_t seed;
+    uint8_t outcome;
+    uint32_t time;                          // ms from the start signal to the end of the run
+    uint32_t laps[SIMULATION_LAPS];         // lap times in ms, 0 if not completed
+    uint8_t curveCount;
+    float odometryError;                    // pose error of the odometry at the end of the run in mm
+};
+
+class SIMULATION {
+    public:
+        SIMULATION_RESULT run(uint32_t seed, uint8_t course, uint8_t maxSpeed);
+
+        FILE* csv = NULL;       // pose and commands of every control tick
+        FILE* recording = NULL; // input recording for the replay
+
+    private:
+        SENSOR_SNAPSHOT snapshot(uint32_t time);
+        void fireUltrasonic(uint32_t time);
+        void record(const RECORD& record);
+        bool checkPillars();
+        uint8_t nextSensor();
+
+        std::mt19937 _random;
+        FIELD _field;
+        ROBOT _robot;
+        ULTRASONIC _ultrasonic;
+        DRIVE_CONTROL _control;
+        bool _started = false;
+
+        // latest values of the sensor boards as WRO Main holds them
+        int32_t _rotation = 0;
+        SENSOR_SNAPSHOT::OBJECT_DATA _object = {};
+        uint32_t _rotationTime = 0;
+        uint32_t _objectTime = 0;
+        int32_t _motorTurns = 0;
+        int16_t _motorRpm = 0;
+        uint16_t _battery = 0;
+
+        uint8_t _nextUltrasonic = 0;
+        uint32_t _ultrasonicTime = 0;
+        float _pillarForward[FIELD_MAX_PILLARS] = {};
+};
+
+#endif
@@ -0,0 +1,157 @@
+/**
+ * Telemetry capture
+ * by TerraForce
+ *
+ * Records the telemetry stream of WRO Main (built with TELEMETRY) from a serial
+ * device or a raw capture file into CSV and / or column files.
+ * Usage: telemetry_capture [--device <tty> [--baud <rate>]] [--csv <file>] [--columns <directory>] [raw file]
+ *
+ * Column files hold one little endian value per sample, "<directory>/<field>.<type>"
+ * with type i8, u8, i16, u16, i32 or u32, listed in "<directory>/schema.txt".
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "telemetry.h"
+
+static speed_t baudConstant(long baud) {
+    switch(baud) {
+        case 115200:    return B115200;
+        case 230400:    return B230400;
+        case 460800:    return B460800;
+        case 921600:    return B921600;
+        case 1000000:   return B1000000;
+        case 2000000:   return B2000000;
+        default:        return 0;
+    }
+}
+
+static FILE* openDevice(const char* path, long baud) {
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    if(fd < 0) return NULL;
+    struct termios tty;
+    if((tcgetattr(fd, &tty) != 0) || (baudConstant(baud) == 0)) {
+        close(fd);
+        return NULL;
+    }
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, baudConstant(baud));
+    cfsetospeed(&tty, baudConstant(baud));
+    tty.c_cc[VMIN] = 1;
+    tty.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tty);
+    return fdopen(fd, "rb");
+}
+
+static int64_t fieldValue(const TELEMETRY_SAMPLE& sample, const TELEMETRY_FIELD& field) {
+    const uint8_t* data = (const uint8_t*)&sample + field.offset;
+    uint32_t raw = 0;
+    for(uint8_t i = 0; i < field.size; i++) {
+        raw |= (uint32_t)data[i] << (8 * i);
+    }
+    if(field.isSigned && (field.size < 4) && (raw & (1UL << (8 * field.size - 1)))) {
+        raw |= ~0UL << (8 * field.size);
+    }
+    return field.isSigned ? (int64_t)(int32_t)raw : (int64_t)raw;
+}
+
+int main(int argc, char** argv) {
+    const char* device = NULL;
+    const char* csvPath = NULL;
+    const char* columnPath = NULL;
+    const char* rawPath = NULL;
+    long baud = 921600;
+    for(int i = 1; i < argc; i++) {
+        if((strcmp(argv[i], "--device") == 0) && (i + 1 < argc)) device = argv[++i];
+        else if((strcmp(argv[i], "--baud") == 0) && (i + 1 < argc)) baud = atol(argv[++i]);
+        else if((strcmp(argv[i], "--csv") == 0) && (i + 1 < argc)) csvPath = argv[++i];
+        else if((strcmp(argv[i], "--columns") == 0) && (i + 1 < argc)) columnPath = argv[++i];
+        else rawPath = argv[i];
+    }
+
+    FILE* input = device ? openDevice(device, baud) : (rawPath ? fopen(rawPath, "rb") : stdin);
+    if(input == NULL) {
+        fprintf(stderr, "Cannot open %s\n", device ? device : rawPath);
+        return 1;
+    }
+
+    FILE* csv = NULL;
+    if(csvPath != NULL) {
+        if((csv = fopen(csvPath, "w")) == NULL) {
+            fprintf(stderr, "Cannot create %s\n", csvPath);
+            return 1;
+        }
+        for(uint8_t i = 0; i < telemetryFieldCount; i++) {
+            fprintf(csv, "%s%c", telemetryFields[i].name, (i < telemetryFieldCount - 1) ? ',' : '\n');
+        }
+    }
+
+    FILE* columns[64] = {};
+    if(columnPath != NULL) {
+        mkdir(columnPath, 0755);
+        char path[512];
+        snprintf(path, sizeof(path), "%s/schema.txt", columnPath);
+        FILE* schema = fopen(path, "w");
+        for(uint8_t i = 0; (i < telemetryFieldCount) && (schema != NULL); i++) {
+            const TELEMETRY_FIELD& field = telemetryFields[i];
+            snprintf(path, sizeof(path), "%s/%s.%c%u", columnPath, field.name, field.isSigned ? 'i' : 'u', field.size * 8);
+            columns[i] = fopen(path, "wb");
+            fprintf(schema, "%s %c%u\n", field.name, field.isSigned ? 'i' : 'u', field.size * 8);
+        }
+        if(schema != NULL) fclose(schema);
+    }
+
+    // frames end at the delimiter, text logging in between fails the CRC and is dropped
+    uint8_t frame[TELEMETRY_MAX_FRAME];
+    size_t length = 0;
+    bool overflow = false;
+    uint32_t samples = 0;
+    uint32_t broken = 0;
+    uint32_t lost = 0;
+    int32_t lastSequence = -1;
+    int c;
+    while((c = fgetc(input)) != EOF) {
+        if(c != FRAMING_DELIMITER) {
+            if(length < sizeof(frame)) frame[length++] = (uint8_t)c;
+            else overflow = true;
+            continue;
+        }
+        TELEMETRY_SAMPLE sample;
+        bool valid = !overflow && (length > 0) && telemetryDecode(frame, length, &sample);
+        broken += !valid && (length > 0);
+        length = 0;
+        overflow = false;
+        if(!valid) continue;
+
+        if(lastSequence >= 0) {
+            lost += (uint16_t)(sample.sequence - lastSequence - 1);
+        }
+        lastSequence = sample.sequence;
+        samples++;
+
+        for(uint8_t i = 0; i < telemetryFieldCount; i++) {
+            const TELEMETRY_FIELD& field = telemetryFields[i];
+            if(csv != NULL) {
+                fprintf(csv, "%lld%c", (long long)fieldValue(sample, field), (i < telemetryFieldCount - 1) ? ',' : '\n');
+            }
+            if(columns[i] != NULL) {
+                fwrite((const uint8_t*)&sample + field.offset, field.size, 1, columns[i]);
+            }
+        }
+        if(device && (samples % 200 == 0)) {
+            fprintf(stderr, "\r%u samples, %u broken, %u lost", samples, broken, lost);
+        }
+    }
+
+    fprintf(stderr, "%u samples, %u broken, %u lost\n", samples, broken, lost);
+    if(csv != NULL) fclose(csv);
+    for(uint8_t i = 0; i < telemetryFieldCount; i++) {
+        if(columns[i] != NULL) fclose(columns[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ * Trace decoder
+ * by TerraForce
+ *
+ * Reads the binary trace stream of WRO Main (live capture or "trace dump")
+ * and prints one line per record, as text or CSV.
+ * Usage: trace_decode [--csv] [file]
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+
+int main(int argc, char** argv) {
+    bool csv = false;
+    FILE* input = stdin;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        }
+        else if((input = fopen(argv[i], "rb")) == NULL) {
+            fprintf(stderr, "Cannot open %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if(csv) {
+        printf("time_us,sequence,event,arg0_name,arg0,arg1_name,arg1\n");
+    }
+
+    // text logging shares the serial line, everything outside valid frames is skipped
+    uint8_t frame[TRACE_FRAME_SIZE];
+    size_t length = 0;
+    uint32_t records = 0;
+    uint32_t lost = 0;
+    uint32_t skipped = 0;
+    int32_t lastSequence = -1;
+    int c;
+    while((c = fgetc(input)) != EOF) {
+        frame[length++] = (uint8_t)c;
+        if((length == 1) && (frame[0] != TRACE_SYNC[0])) {
+            length = 0;
+            skipped++;
+            continue;
+        }
+        if(length < TRACE_FRAME_SIZE) continue;
+
+        TRACE_RECORD record;
+        if(!TRACE::unframe(frame, &record)) {
+            // resynchronise on the next sync byte inside the rejected frame
+            size_t next = 1;
+            while((next < length) && (frame[next] != TRACE_SYNC[0])) next++;
+            skipped += next;
+            memmove(frame, frame + next, length - next);
+            length -= next;
+            continue;
+        }
+        length = 0;
+
+        if(lastSequence >= 0) {
+            lost += (uint16_t)(record.sequence - lastSequence - 1);
+        }
+        lastSequence = record.sequence;
+        records++;
+
+        const TRACE_EVENT_INFO& info = traceEvents[record.event];
+        if(csv) {
+            printf("%u,%u,%s,%s,%d,%s,%d\n", record.time, record.sequence, info.name, info.args[0], record.args[0], info.args[1], record.args[1]);
+        }
+        else {
+            printf("%10.6f  %-12s %s=%d %s=%d\n", record.time / 1000000.0, info.name, info.args[0], record.args[0], info.args[1], record.args[1]);
+        }
+    }
+
+    fprintf(stderr, "%u records, %u lost, %u bytes skipped\n", records, lost, skipped);
+    if(input != stdin) {
+        fclose(input);
+    }
+    return 0;
+}